@@ -126,3 +126,23 @@ int FreeD_D1_pack(unsigned char *buf, int len, FreeD_D1_t* src)
 
     return 0;
 }
+
+int FreeD_D1_check(unsigned char *buf, int len)
+{
+    int i;
+    unsigned char cs = 0x40;
+
+    if (len != FREE_D_D1_PACKET_SIZE)
+        return -EINVAL;
+
+    if (buf[0] != 0xD1)
+        return -EFAULT;
+
+    for (i = 0; i < (FREE_D_D1_PACKET_SIZE - 1); i++)
+        cs -= buf[i];
+
+    if (buf[28] != cs)
+        return -EIO;
+
+    return 0;
+}
\ No newline at end of file
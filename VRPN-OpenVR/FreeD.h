@@ -24,8 +24,24 @@ typedef struct
 
 } FreeD_D1_t;
 
+/*
+    Optional usage of Spare field (big endian 16 bits):
+
+        bit 15      - sequence counter present
+        bits 12-14  - camera tracking state, 0 - tracking OK
+        bits 0-11   - sequence counter, incremented for every packet sent to target
+*/
+#define FREE_D_SPARE_SEQ_FLAG       0x8000
+#define FREE_D_SPARE_SEQ_MASK       0x0FFF
+#define FREE_D_SPARE_STATE_MASK     0x7000
+#define FREE_D_SPARE_STATE_SHIFT    12
+
+#define FREE_D_SPARE_GET(D) (((D)->Spare[0] << 8) | (D)->Spare[1])
+#define FREE_D_SPARE_SET(D, V) do { (D)->Spare[0] = ((V) >> 8) & 0xFF; (D)->Spare[1] = (V) & 0xFF; } while (0)
+
 int FreeD_D1_unpack(unsigned char *buf, int len, FreeD_D1_t* dst);
 int FreeD_D1_pack(unsigned char *buf, int len, FreeD_D1_t* src);
+int FreeD_D1_check(unsigned char *buf, int len);
 
 #ifdef __cplusplus
 };
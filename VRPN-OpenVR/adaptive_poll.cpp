@@ -0,0 +1,108 @@
+#include "adaptive_poll.h"
+#include <math.h>
+
+adaptive_poll::adaptive_poll(int full_interval, int idle_interval, double _static_time) :
+    full(full_interval), idle(idle_interval), mode(POLL_FULL), static_time(_static_time),
+    last_motion(-1.0), tick_prev(-1.0), idle_time(0.0), run_time(0.0), motion(false),
+    wakeups(0), wakeup_gap_last(0.0), wakeup_gap_max(0.0)
+{
+}
+
+/* anchor is created on first pose of source, which is device discovery tick */
+void adaptive_poll::pose(const void* src, const q_vec_type pos, const q_type quat, int valid)
+{
+    poll_anchor_t& a = anchors[src];
+    double d, dot;
+
+    if (valid != a.valid)
+    {
+        motion = true;
+        q_vec_copy(a.pos, pos);
+        q_copy(a.quat, quat);
+        a.valid = valid;
+        return;
+    }
+    if (!valid)
+        return;
+
+    d = sqrt((pos[0] - a.pos[0]) * (pos[0] - a.pos[0]) + (pos[1] - a.pos[1]) * (pos[1] - a.pos[1]) + (pos[2] - a.pos[2]) * (pos[2] - a.pos[2]));
+    dot = fabs(quat[0] * a.quat[0] + quat[1] * a.quat[1] + quat[2] * a.quat[2] + quat[3] * a.quat[3]);
+    if (d > POLL_MOTION_POS || 2.0 * acos(dot > 1.0 ? 1.0 : dot) > POLL_MOTION_ROT * Q_PI / 180.0)
+    {
+        motion = true;
+        q_vec_copy(a.pos, pos);
+        q_copy(a.quat, quat);
+    }
+}
+
+/* end of tick: decide mode, return interval to next tick, ms */
+int adaptive_poll::tick(double now, bool consumers)
+{
+    int next;
+
+    if (motion || last_motion < 0.0)
+        last_motion = now;
+    motion = false;
+
+    next = !consumers ? POLL_IDLE_NOBODY : now - last_motion >= static_time ? POLL_IDLE_STATIC : POLL_FULL;
+
+    if (tick_prev >= 0.0)
+    {
+        run_time += now - tick_prev;
+        if (mode != POLL_FULL)
+            idle_time += now - tick_prev;
+
+        /* whatever woke us happened within this gap, it bounds wakeup latency */
+        if (mode != POLL_FULL && next == POLL_FULL)
+        {
+            wakeups++;
+            wakeup_gap_last = now - tick_prev;
+            if (wakeup_gap_last > wakeup_gap_max)
+                wakeup_gap_max = wakeup_gap_last;
+        }
+    }
+
+    mode = next;
+    tick_prev = now;
+
+    return getInterval();
+}
+
+int adaptive_poll::getInterval()
+{
+    return mode == POLL_FULL ? full : idle;
+}
+
+int adaptive_poll::getMode()
+{
+    return mode;
+}
+
+const char* adaptive_poll::getModeName(int mode)
+{
+    return
+        mode == POLL_FULL ? "full rate" :
+        mode == POLL_IDLE_STATIC ? "idle, poses static" :
+        mode == POLL_IDLE_NOBODY ? "idle, no consumers" :
+        "unknown";
+}
+
+long adaptive_poll::getWakeups()
+{
+    return wakeups;
+}
+
+double adaptive_poll::getWakeupGapLast()
+{
+    return wakeup_gap_last;
+}
+
+double adaptive_poll::getWakeupGapMax()
+{
+    return wakeup_gap_max;
+}
+
+double adaptive_poll::getIdleShare()
+{
+    return run_time > 0.0 ? idle_time / run_time : 0.0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <quat.h>
+
+#define POLL_IDLE_MAX       100         // ms, longest idle poll interval, bounds wakeup gap
+#define POLL_MOTION_POS     0.0005      // meters away from pose of last motion that count as motion
+#define POLL_MOTION_ROT     0.1         // degrees, same for rotation
+
+/* poll modes */
+#define POLL_FULL           0           // sleep_interval
+#define POLL_IDLE_STATIC    1           // all poses static for a while
+#define POLL_IDLE_NOBODY    2           // no VRPN client connected and no outputs
+
+typedef struct
+{
+    q_vec_type pos;
+    q_type quat;
+    int valid;
+} poll_anchor_t;
+
+/*
+    Adaptive poll rate: main loop runs at sleep_interval while anybody
+    consumes poses and something moves, otherwise at idle interval. Every
+    pose is compared with pose of its source at last motion (not with
+    previous tick, so slow drift is caught too). Motion or consumer
+    appearing is seen on the first idle tick after it and the next tick
+    is full rate again. Moment of motion between ticks is not known, so
+    wakeup latency is not measured: wakeup gap, time from previous (idle)
+    tick to tick that saw it, is its upper bound, limited by idle interval.
+*/
+class adaptive_poll
+{
+public:
+    adaptive_poll(int full_interval, int idle_interval, double static_time);
+    void pose(const void* src, const q_vec_type pos, const q_type quat, int valid);
+    int tick(double now, bool consumers);
+    int getInterval();
+    int getMode();
+    static const char* getModeName(int mode);
+    long getWakeups();
+    double getWakeupGapLast();
+    double getWakeupGapMax();
+    double getIdleShare();
+
+private:
+    int full, idle, mode;
+    double static_time;
+    double last_motion, tick_prev, idle_time, run_time;
+    bool motion;
+    long wakeups;
+    double wakeup_gap_last, wakeup_gap_max;         // seconds
+    std::map<const void*, poll_anchor_t> anchors;   // by tracker
+};
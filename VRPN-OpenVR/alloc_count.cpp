@@ -0,0 +1,146 @@
+#include "alloc_count.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <new>
+
+#if defined(ALLOC_COUNT)
+
+/* per thread, helper threads (OpenVR attach, pacer) do not disturb tick */
+static thread_local uint64_t allocations = 0;
+
+#if defined(__GLIBC__)
+
+/*
+    glibc allows malloc replacement: these wrappers are called by libc
+    itself too (strdup, asprintf, stdio buffers), operator new ends here
+    as well, so it does not count on its own.
+*/
+#define ALLOC_COUNT_MALLOC
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t align, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) noexcept
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) noexcept
+{
+    allocations++;
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size) noexcept
+{
+    allocations++;
+    return __libc_realloc(p, size);
+}
+
+void* memalign(size_t align, size_t size) noexcept
+{
+    allocations++;
+    return __libc_memalign(align, size);
+}
+
+void* aligned_alloc(size_t align, size_t size) noexcept
+{
+    allocations++;
+    return __libc_memalign(align, size);
+}
+
+int posix_memalign(void** p, size_t align, size_t size) noexcept
+{
+    allocations++;
+    *p = __libc_memalign(align, size);
+    return *p ? 0 : ENOMEM;
+}
+
+void free(void* p) noexcept
+{
+    __libc_free(p);
+}
+
+}
+
+#endif
+
+static void* counted_alloc(size_t size)
+{
+#if !defined(ALLOC_COUNT_MALLOC)
+    allocations++;
+#endif
+    return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+    void* p = counted_alloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+uint64_t alloc_count()
+{
+    return allocations;
+}
+
+bool alloc_count_enabled()
+{
+    return true;
+}
+
+bool alloc_count_malloc()
+{
+#if defined(ALLOC_COUNT_MALLOC)
+    return true;
+#else
+    return false;
+#endif
+}
+
+#else
+
+uint64_t alloc_count()
+{
+    return 0;
+}
+
+bool alloc_count_enabled()
+{
+    return false;
+}
+
+bool alloc_count_malloc()
+{
+    return false;
+}
+
+#endif
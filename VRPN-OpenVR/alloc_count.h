@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+    Heap allocation counter used to check that steady-state tick does not
+    allocate. When built with ALLOC_COUNT defined, global operator new and
+    delete are replaced with counting versions, with glibc malloc family is
+    wrapped as well, so C allocations (strdup, asprintf, stdio) count too.
+    Counter is per thread, otherwise it is always zero.
+*/
+uint64_t alloc_count();
+bool alloc_count_enabled();
+bool alloc_count_malloc();
@@ -0,0 +1,142 @@
+#include <string.h>
+#include <errno.h>
+
+#include "batch.h"
+
+static void pack_be16(unsigned char *buf, uint32_t v)
+{
+    buf[0] = (v >> 8) & 0xFF;
+    buf[1] = v & 0xFF;
+}
+
+static uint32_t unpack_be16(unsigned char *buf)
+{
+    return ((uint32_t)buf[0] << 8) | buf[1];
+}
+
+static void pack_be32(unsigned char *buf, uint32_t v)
+{
+    buf[0] = (v >> 24) & 0xFF;
+    buf[1] = (v >> 16) & 0xFF;
+    buf[2] = (v >> 8) & 0xFF;
+    buf[3] = v & 0xFF;
+}
+
+static uint32_t unpack_be32(unsigned char *buf)
+{
+    return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3];
+}
+
+static void pack_be64(unsigned char *buf, uint64_t v)
+{
+    pack_be32(buf, (uint32_t)(v >> 32));
+    pack_be32(buf + 4, (uint32_t)v);
+}
+
+static uint64_t unpack_be64(unsigned char *buf)
+{
+    return ((uint64_t)unpack_be32(buf) << 32) | unpack_be32(buf + 4);
+}
+
+static void pack_doubles(unsigned char *buf, const double* d, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        uint64_t v;
+        memcpy(&v, &d[i], sizeof(v));
+        pack_be64(buf + i * 8, v);
+    }
+}
+
+static void unpack_doubles(unsigned char *buf, double* d, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        uint64_t v = unpack_be64(buf + i * 8);
+        memcpy(&d[i], &v, sizeof(v));
+    }
+}
+
+int batch_header_pack(unsigned char *buf, int len, batch_header_t* src)
+{
+    if (len < BATCH_HEADER_SIZE)
+        return -EINVAL;
+
+    pack_be32(buf, BATCH_MAGIC);
+    buf[4] = BATCH_VERSION;
+    buf[5] = src->count;
+    buf[6] = src->coord;
+    buf[7] = 0;
+    pack_be32(buf + 8, src->seq);
+    pack_be16(buf + 12, src->part);
+    pack_be16(buf + 14, src->parts);
+    pack_be64(buf + 16, (uint64_t)src->t_tick);
+
+    return 0;
+}
+
+int batch_header_unpack(unsigned char *buf, int len, batch_header_t* dst)
+{
+    memset(dst, 0, sizeof(*dst));
+
+    if (len < BATCH_HEADER_SIZE)
+        return -EINVAL;
+
+    if (unpack_be32(buf) != BATCH_MAGIC || buf[4] != BATCH_VERSION)
+        return -EFAULT;
+
+    dst->count = buf[5];
+    dst->coord = buf[6];
+    dst->seq = unpack_be32(buf + 8);
+    dst->part = unpack_be16(buf + 12);
+    dst->parts = unpack_be16(buf + 14);
+    dst->t_tick = (int64_t)unpack_be64(buf + 16);
+
+    if (len < BATCH_HEADER_SIZE + dst->count * BATCH_CAMERA_SIZE || dst->part >= dst->parts)
+        return -EINVAL;
+
+    return 0;
+}
+
+int batch_camera_pack(unsigned char *buf, int len, batch_camera_t* src)
+{
+    if (len < BATCH_CAMERA_SIZE)
+        return -EINVAL;
+
+    memset(buf, 0, BATCH_CAMERA_SIZE);
+    buf[0] = src->id;
+    buf[1] = src->state;
+    buf[2] = src->trackers;
+
+    pack_doubles(buf + 8, src->pos, 3);
+    pack_doubles(buf + 32, src->quat, 4);
+    pack_doubles(buf + 64, src->vel, 3);
+    pack_doubles(buf + 88, src->avel, 3);
+    pack_be64(buf + 112, (uint64_t)src->timestamp);
+
+    return 0;
+}
+
+int batch_camera_unpack(unsigned char *buf, int len, batch_camera_t* dst)
+{
+    memset(dst, 0, sizeof(*dst));
+
+    if (len < BATCH_CAMERA_SIZE)
+        return -EINVAL;
+
+    dst->id = buf[0];
+    dst->state = buf[1];
+    dst->trackers = buf[2];
+
+    unpack_doubles(buf + 8, dst->pos, 3);
+    unpack_doubles(buf + 32, dst->quat, 4);
+    unpack_doubles(buf + 64, dst->vel, 3);
+    unpack_doubles(buf + 88, dst->avel, 3);
+    dst->timestamp = (int64_t)unpack_be64(buf + 112);
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef batch_h
+#define batch_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/*
+    Batch camera protocol: full precision poses of all cameras of a tick in
+    one UDP datagram. All fields are big endian.
+
+    Header (24 bytes):
+
+        0   magic 'VFOB'
+        4   version
+        5   camera records count
+        6   coordinate convention of poses (coord_id, see coord.h)
+        7   reserved
+        8   sequence number, incremented for every datagram sent to target
+        12  datagram index within tick
+        14  datagrams count of tick
+        16  tick time, microseconds since epoch
+
+    Payload is count of camera records (120 bytes each):
+
+        0   camera ID (same as FreeD)
+        1   tracking state (cam_tracking_state)
+        2   number of trackers fused
+        3   reserved
+        4   reserved
+        8   position, 3 x double, units of convention
+        32  rotation, 4 x double, q_type order
+        64  velocity, 3 x double, units per second
+        88  angular velocity, 3 x double, radians per second, axes as rotation
+        112 pose time, microseconds since epoch (tick time - delay)
+
+    Tick with more than BATCH_MAX_CAMERAS cameras is split into several
+    datagrams, so every datagram fits into ethernet MTU.
+*/
+
+#define BATCH_MAGIC         0x56464F42  /* "VFOB" */
+#define BATCH_VERSION       1
+#define BATCH_HEADER_SIZE   24
+#define BATCH_CAMERA_SIZE   120
+#define BATCH_MAX_CAMERAS   12
+#define BATCH_PACKET_MAX    (BATCH_HEADER_SIZE + BATCH_MAX_CAMERAS * BATCH_CAMERA_SIZE)
+
+typedef struct
+{
+    int count;
+    int coord;
+    uint32_t seq;
+    int part;
+    int parts;
+    int64_t t_tick;
+} batch_header_t;
+
+typedef struct
+{
+    int id;
+    int state;
+    int trackers;
+    double pos[3];
+    double quat[4];
+    double vel[3];
+    double avel[3];
+    int64_t timestamp;
+} batch_camera_t;
+
+int batch_header_pack(unsigned char *buf, int len, batch_header_t* src);
+int batch_header_unpack(unsigned char *buf, int len, batch_header_t* dst);
+int batch_camera_pack(unsigned char *buf, int len, batch_camera_t* src);
+int batch_camera_unpack(unsigned char *buf, int len, batch_camera_t* dst);
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif /* batch_h */
@@ -0,0 +1,166 @@
+#include "batch_sender.h"
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <ws2tcpip.h>
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#define closesocket close
+#endif
+
+/*
+    Batch target is specified as:
+
+        <host>:<port>[,<option>=<value>...]
+
+    options:
+
+        rate=<hz>   - send not faster then <hz> ticks per second
+        coord=<c>   - coordinate convention (see coord.h), default is ue4
+        delay=<d>   - send poses of <d> ago, same as FreeD target option
+*/
+batch_sender::batch_sender(const char* _target) :
+    sock(-1), coord(COORD_UE4), delay(0.0), period(0.0), next(0.0), seq(0), sent(0), errors(0), target(_target)
+{
+    char *port, *opts, *host = strdup(_target);
+
+    memset(&addr, 0, sizeof(addr));
+
+    opts = strchr(host, ',');
+    if (opts)
+    {
+        *opts = 0; opts++;
+    }
+
+    /* parse options */
+    while (opts && *opts)
+    {
+        char *val, *next_opt = strchr(opts, ',');
+
+        if (next_opt)
+        {
+            *next_opt = 0; next_opt++;
+        }
+
+        val = strchr(opts, '=');
+        if (val)
+        {
+            *val = 0; val++;
+
+            if (!strcmp(opts, "rate") && atof(val) > 0.0)
+                period = 1.0 / atof(val);
+            else if (!strcmp(opts, "coord") && coord_find(val) >= 0)
+                coord = coord_find(val);
+            else if (!strcmp(opts, "delay") && vrpn_Tracker_Camera::parseDelay(val) >= 0.0)
+                delay = vrpn_Tracker_Camera::parseDelay(val);
+            else
+                std::cerr << "Unknown batch target option [" << opts << "=" << val << "]" << std::endl;
+        }
+
+        opts = next_opt;
+    }
+
+    port = strrchr(host, ':');
+    if (port)
+    {
+        *port = 0; port++;
+
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(host);
+        addr.sin_port = htons((unsigned short)atoi(port));
+
+        sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0)
+            std::cerr << "Failed to create batch socket" << std::endl;
+    }
+    else
+        std::cerr << "Failed to parse batch target [" << _target << "], should be host:port" << std::endl;
+
+    free(host);
+}
+
+batch_sender::~batch_sender()
+{
+    if (sock >= 0)
+        closesocket(sock);
+}
+
+bool batch_sender::isOpen()
+{
+    return sock >= 0;
+}
+
+const std::string& batch_sender::getTarget()
+{
+    return target;
+}
+
+long batch_sender::getSent()
+{
+    return sent;
+}
+
+long batch_sender::getErrors()
+{
+    return errors;
+}
+
+void batch_sender::send(const std::list<std::unique_ptr<vrpn_Tracker_Camera>>& cameras, struct timeval *tv)
+{
+    int cnt = 0;
+    batch_header_t hdr;
+    unsigned char buf[BATCH_PACKET_MAX];
+    double now = tv->tv_sec + tv->tv_usec / 1000000.0;
+
+    if (sock < 0 || cameras.empty())
+        return;
+
+    /* decimate by rate, keep average rate but do not catch up after stalls */
+    if (period > 0.0)
+    {
+        if (now < next)
+            return;
+        next += period;
+        if (next < now)
+            next = now + period;
+    }
+
+    hdr.coord = coord;
+    hdr.part = 0;
+    hdr.parts = (int)((cameras.size() + BATCH_MAX_CAMERAS - 1) / BATCH_MAX_CAMERAS);
+    hdr.t_tick = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+
+    for (const auto& ci : cameras)
+    {
+        batch_camera_t cam;
+
+        cam.id = ci->getIdx() + 1;
+        cam.state = ci->getTrackingState();
+        cam.trackers = ci->getFusedCount();
+        ci->getOutputPose(coord, delay, now, cam.pos, cam.quat, cam.vel, cam.avel);
+        cam.timestamp = hdr.t_tick - (int64_t)(delay * 1000000.0);
+
+        batch_camera_pack(buf + BATCH_HEADER_SIZE + cnt * BATCH_CAMERA_SIZE, BATCH_CAMERA_SIZE, &cam);
+        cnt++;
+
+        /* datagram is full or last camera */
+        if (cnt == BATCH_MAX_CAMERAS || hdr.part * BATCH_MAX_CAMERAS + cnt == (int)cameras.size())
+        {
+            hdr.count = cnt;
+            hdr.seq = seq++;
+            batch_header_pack(buf, BATCH_HEADER_SIZE, &hdr);
+
+            if (sendto(sock, (const char*)buf, BATCH_HEADER_SIZE + cnt * BATCH_CAMERA_SIZE, 0, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+                errors++;
+            else
+                sent++;
+
+            hdr.part++;
+            cnt = 0;
+        }
+    }
+}
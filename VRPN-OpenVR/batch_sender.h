@@ -0,0 +1,41 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include "batch.h"
+#include "vrpn_Tracker_Camera.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+
+/*
+    Batch camera output: poses of all cameras of a tick in full precision
+    with velocities and tracking state, see batch.h for packet layout.
+*/
+class batch_sender
+{
+public:
+    batch_sender(const char* target);
+    ~batch_sender();
+    bool isOpen();
+    const std::string& getTarget();
+    long getSent();
+    long getErrors();
+    void send(const std::list<std::unique_ptr<vrpn_Tracker_Camera>>& cameras, struct timeval *tv);
+
+private:
+    int sock;
+    int coord;              // coordinate convention of poses
+    double delay;           // seconds, send poses of that time ago
+    double period;          // seconds between ticks sent, 0 - every tick
+    double next;
+    uint32_t seq;
+    long sent, errors;      // datagrams sent and failed
+    std::string target;
+    struct sockaddr_in addr;
+};
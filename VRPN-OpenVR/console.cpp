@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "console.h"
 
+#if defined(_WIN32)
+
 char console_keypress(HANDLE hStdin)
 {
     DWORD ne = 0;
@@ -106,7 +109,88 @@ void console_cls(HANDLE hConsole)
     SetConsoleCursorPosition(hConsole, coordScreen);
 }
 
-void console_put(char* str)
+void console_home(HANDLE hConsole)
+{
+    SetConsoleCursorPosition(hConsole, { 0, 0 });
+}
+
+#else
+
+#include <unistd.h>
+#include <termios.h>
+
+static struct termios console_termios_saved;
+static int console_tty = 0;
+
+static void console_restore()
+{
+    tcsetattr(STDIN_FILENO, TCSANOW, &console_termios_saved);
+    fputs("\x1b[?25h", stdout);
+    fflush(stdout);
+}
+
+char console_keypress(HANDLE hStdin)
+{
+    char c;
+
+    /* terminal stdin is non-canonical with VMIN=0, so read never blocks,
+       pipe or file stdin would block the loop and is not polled at all */
+    if (!console_tty)
+        return 0;
+
+    if (read(hStdin, &c, 1) == 1)
+        return c;
+
+    return 0;
+}
+
+void console_setup(HANDLE *p_c_in, HANDLE *p_c_out)
+{
+    struct termios t;
+
+    *p_c_in = STDIN_FILENO;
+    *p_c_out = STDOUT_FILENO;
+
+    // single keypress input without echo
+    if (isatty(STDIN_FILENO) && !tcgetattr(STDIN_FILENO, &console_termios_saved))
+    {
+        t = console_termios_saved;
+        t.c_lflag &= ~(ICANON | ECHO);
+        t.c_cc[VMIN] = 0;
+        t.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &t);
+        atexit(console_restore);
+        console_tty = 1;
+    }
+
+    // resize terminal and hide cursor
+    printf("\x1b[8;%d;%dt\x1b[?25l", console_window_height, console_window_width);
+
+    console_cls(*p_c_out);
+}
+
+// dprintf would allocate stream buffer on every call
+static void console_write(HANDLE hConsole, const char* seq)
+{
+    if (write(hConsole, seq, strlen(seq)) < 0)
+        return;
+}
+
+void console_cls(HANDLE hConsole)
+{
+    fflush(stdout);
+    console_write(hConsole, "\x1b[2J\x1b[H");
+}
+
+void console_home(HANDLE hConsole)
+{
+    fflush(stdout);
+    console_write(hConsole, "\x1b[H");
+}
+
+#endif
+
+void console_put(const char* str)
 {
     char buf[console_window_width], fmt[16];
     snprintf(fmt, sizeof(fmt), "%%-%ds", console_window_width - 2);
@@ -114,6 +198,21 @@ void console_put(char* str)
     fprintf(stdout, "%s\n", buf);
 }
 
+/* formatted line into stack buffer, no heap allocation */
+void console_printf(const char* format, ...)
+{
+    va_list ap;
+    char buf[console_window_width];
+
+    va_start(ap, format);
+    vsnprintf(buf, sizeof(buf), format, ap);
+    va_end(ap);
+
+    console_put(buf);
+}
+
+#if defined(_WIN32)
+
 int vscprintf(const char *format, va_list ap)
 {
     va_list ap_copy;
@@ -148,3 +247,5 @@ int asprintf(char **strp, const char *format, ...)
     va_end(ap);
     return retval;
 }
+
+#endif
@@ -1,16 +1,25 @@
 #ifndef _console_h
 #define _console_h
 
+#if defined(_WIN32)
 #include <windows.h>
+#else
+/* ANSI terminal, handles are file descriptors */
+typedef int HANDLE;
+#endif
 
 #define console_window_width 120
 #define console_window_height 50
 
 void console_setup(HANDLE *p_c_out, HANDLE *p_c_in);
 void console_cls(HANDLE hConsole);
+void console_home(HANDLE hConsole);
 char console_keypress(HANDLE hStdin);
-void console_put(char* str);
+void console_put(const char* str);
+void console_printf(const char* format, ...);
 
+#if defined(_WIN32)
 int asprintf(char **strp, const char *format, ...);
+#endif
 
 #endif
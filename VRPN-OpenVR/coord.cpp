@@ -0,0 +1,36 @@
+#include "coord.h"
+#include <string.h>
+
+#define COORD_ROW(F) \
+    { \
+        coord_convert<F, COORD_OPENVR>::pose, \
+        coord_convert<F, COORD_UE4>::pose, \
+        coord_convert<F, COORD_UE4CM>::pose, \
+        coord_convert<F, COORD_UNITY>::pose, \
+        coord_convert<F, COORD_BLENDER>::pose, \
+    }
+
+static const coord_pose_fn coord_converters[COORD_COUNT][COORD_COUNT] =
+{
+    COORD_ROW(COORD_OPENVR),
+    COORD_ROW(COORD_UE4),
+    COORD_ROW(COORD_UE4CM),
+    COORD_ROW(COORD_UNITY),
+    COORD_ROW(COORD_BLENDER),
+};
+
+int coord_find(const char* name)
+{
+    int i;
+
+    for (i = 0; i < COORD_COUNT; i++)
+        if (!strcmp(name, coord_conventions[i].name))
+            return i;
+
+    return -1;
+}
+
+coord_pose_fn coord_converter(int from, int to)
+{
+    return coord_converters[from][to];
+}
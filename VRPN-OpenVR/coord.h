@@ -0,0 +1,131 @@
+#pragma once
+
+#include <quat.h>
+
+/*
+    Coordinate conventions of pose consumers.
+
+    Every convention is described as a swizzle/sign table relative to
+    OpenVR world (right-handed, +y up, -z forward, meters):
+
+        vec[i]  = vec_sign[i]  * openvr_vec[vec_axis[i]] * scale
+        quat[i] = quat_sign[i] * openvr_quat[quat_axis[i]]
+
+    Quaternions are in q_type order (x, y, z, w). Conversion between any
+    two conventions is composed from tables at compile time, so every
+    instantiation is plain copy with constant signs, without branches or
+    trigonometry.
+
+        openvr  - OpenVR world as is
+        ue4     - Unreal, +x forward, +y right, +z up, meters (values camera
+                  sends over VRPN and FreeD by default)
+        ue4cm   - same axes, centimeters (native Unreal units)
+        unity   - Unity, left-handed, +x right, +y up, +z forward, meters
+        blender - Blender, right-handed, +x right, +y forward, +z up, meters
+*/
+
+enum coord_id
+{
+    COORD_OPENVR = 0,
+    COORD_UE4,
+    COORD_UE4CM,
+    COORD_UNITY,
+    COORD_BLENDER,
+    COORD_COUNT
+};
+
+typedef struct
+{
+    const char* name;
+    int vec_axis[3];
+    int vec_sign[3];
+    int quat_axis[4];
+    int quat_sign[4];
+    double scale;           // output units per meter
+} coord_convention_t;
+
+static constexpr coord_convention_t coord_conventions[COORD_COUNT] =
+{
+    { "openvr",  { 0, 1, 2 }, {  1, 1,  1 }, { 0, 1, 2, 3 }, {  1,  1,  1, 1 }, 1.0 },
+    { "ue4",     { 2, 0, 1 }, { -1, 1,  1 }, { 2, 0, 1, 3 }, { -1,  1,  1, 1 }, 1.0 },
+    { "ue4cm",   { 2, 0, 1 }, { -1, 1,  1 }, { 2, 0, 1, 3 }, { -1,  1,  1, 1 }, 100.0 },
+    { "unity",   { 0, 1, 2 }, {  1, 1, -1 }, { 0, 1, 2, 3 }, { -1, -1,  1, 1 }, 1.0 },
+    { "blender", { 0, 2, 1 }, {  1, -1, 1 }, { 0, 2, 1, 3 }, {  1, -1,  1, 1 }, 1.0 },
+};
+
+/* openvr component that lands into component i of convention C, and back */
+constexpr int coord_vec_inv_axis(int c, int i)
+{
+    return coord_conventions[c].vec_axis[0] == i ? 0 : coord_conventions[c].vec_axis[1] == i ? 1 : 2;
+}
+
+constexpr int coord_quat_inv_axis(int c, int i)
+{
+    return coord_conventions[c].quat_axis[0] == i ? 0 : coord_conventions[c].quat_axis[1] == i ? 1 :
+        coord_conventions[c].quat_axis[2] == i ? 2 : 3;
+}
+
+/* component i of convention TO is sign * component axis of convention FROM */
+constexpr int coord_vec_axis(int from, int to, int i)
+{
+    return coord_vec_inv_axis(from, coord_conventions[to].vec_axis[i]);
+}
+
+constexpr double coord_vec_factor(int from, int to, int i)
+{
+    return coord_conventions[to].vec_sign[i] * coord_conventions[from].vec_sign[coord_vec_axis(from, to, i)]
+        * coord_conventions[to].scale / coord_conventions[from].scale;
+}
+
+constexpr int coord_quat_axis(int from, int to, int i)
+{
+    return coord_quat_inv_axis(from, coord_conventions[to].quat_axis[i]);
+}
+
+constexpr double coord_quat_sign(int from, int to, int i)
+{
+    return coord_conventions[to].quat_sign[i] * coord_conventions[from].quat_sign[coord_quat_axis(from, to, i)];
+}
+
+template <int FROM, int TO>
+struct coord_convert
+{
+    static inline void vec(const q_vec_type src, q_vec_type dst)
+    {
+        constexpr int a0 = coord_vec_axis(FROM, TO, 0), a1 = coord_vec_axis(FROM, TO, 1), a2 = coord_vec_axis(FROM, TO, 2);
+        constexpr double f0 = coord_vec_factor(FROM, TO, 0), f1 = coord_vec_factor(FROM, TO, 1), f2 = coord_vec_factor(FROM, TO, 2);
+        double x = src[a0], y = src[a1], z = src[a2];
+
+        dst[0] = f0 * x;
+        dst[1] = f1 * y;
+        dst[2] = f2 * z;
+    }
+
+    static inline void quat(const q_type src, q_type dst)
+    {
+        constexpr int a0 = coord_quat_axis(FROM, TO, 0), a1 = coord_quat_axis(FROM, TO, 1),
+            a2 = coord_quat_axis(FROM, TO, 2), a3 = coord_quat_axis(FROM, TO, 3);
+        constexpr double s0 = coord_quat_sign(FROM, TO, 0), s1 = coord_quat_sign(FROM, TO, 1),
+            s2 = coord_quat_sign(FROM, TO, 2), s3 = coord_quat_sign(FROM, TO, 3);
+        double x = src[a0], y = src[a1], z = src[a2], w = src[a3];
+
+        dst[0] = s0 * x;
+        dst[1] = s1 * y;
+        dst[2] = s2 * z;
+        dst[3] = s3 * w;
+    }
+
+    static void pose(const q_vec_type src_pos, const q_type src_quat, q_vec_type dst_pos, q_type dst_quat)
+    {
+        vec(src_pos, dst_pos);
+        quat(src_quat, dst_quat);
+    }
+};
+
+typedef void (*coord_pose_fn)(const q_vec_type src_pos, const q_type src_quat, q_vec_type dst_pos, q_type dst_quat);
+
+/* convention by its command line name, -1 if unknown */
+int coord_find(const char* name);
+
+/* pose conversion instantiated for given pair of conventions */
+coord_pose_fn coord_converter(int from, int to);
@@ -0,0 +1,54 @@
+#include "derivatives.h"
+#include <string.h>
+#include <math.h>
+
+void deriv_reset(deriv_state_t* st)
+{
+    memset(st, 0, sizeof(*st));
+}
+
+void deriv_update(deriv_state_t* st, double t, const q_vec_type vel, const q_vec_type avel)
+{
+    int i;
+    double dt = t - st->t;
+
+    /* first sample or time gap: no acceleration, start over */
+    if (!st->samples || dt <= 0.0 || dt > 10.0 * DERIV_ACC_TAU)
+    {
+        for (i = 0; i < 3; i++)
+            st->acc[i] = st->aacc[i] = 0.0;
+    }
+    else
+    {
+        double a = 1.0 - exp(-dt / DERIV_ACC_TAU);
+
+        for (i = 0; i < 3; i++)
+        {
+            st->acc[i] += a * ((vel[i] - st->vel[i]) / dt - st->acc[i]);
+            st->aacc[i] += a * ((avel[i] - st->avel[i]) / dt - st->aacc[i]);
+        }
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        st->vel[i] = vel[i];
+        st->avel[i] = avel[i];
+    }
+    st->t = t;
+    st->samples++;
+}
+
+/* rotation by angular rate vector over dt */
+void deriv_quat(q_type quat, const q_vec_type rate, double dt)
+{
+    double w = sqrt(rate[0] * rate[0] + rate[1] * rate[1] + rate[2] * rate[2]);
+
+    if (w * dt < 1e-12)
+    {
+        quat[0] = quat[1] = quat[2] = 0.0;
+        quat[3] = 1.0;
+        return;
+    }
+
+    q_from_axis_angle(quat, rate[0] / w, rate[1] / w, rate[2] / w, w * dt);
+}
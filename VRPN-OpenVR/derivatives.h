@@ -0,0 +1,33 @@
+#pragma once
+
+#include <quat.h>
+
+/* level of VRPN derivative reports */
+#define DERIV_NONE          0
+#define DERIV_VELOCITY      1       // velocity reports
+#define DERIV_ACCELERATION  2       // velocity and acceleration reports
+
+#define DERIV_QUAT_DT       0.01    // seconds, interval VRPN vel_quat/acc_quat rotation is given for
+#define DERIV_ACC_TAU       0.02    // seconds, time constant of acceleration low-pass
+
+/*
+    Velocity of tracked pose and acceleration estimated from it. Angular
+    rates are vectors (axis * radians per second) in the same space as
+    position, rotation increment is applied from the left:
+
+        q(t + dt) = vel_quat * q(t)
+
+    Acceleration is difference of successive velocities, low-pass filtered,
+    since neither OpenVR nor camera pipeline provide it directly.
+*/
+typedef struct
+{
+    double t;               // time of last sample, seconds
+    q_vec_type vel, avel;   // meters per second, radians per second
+    q_vec_type acc, aacc;   // meters per second^2, radians per second^2
+    int samples;
+} deriv_state_t;
+
+void deriv_reset(deriv_state_t* st);
+void deriv_update(deriv_state_t* st, double t, const q_vec_type vel, const q_vec_type avel);
+void deriv_quat(q_type quat, const q_vec_type rate, double dt);
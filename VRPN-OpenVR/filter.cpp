@@ -1,5 +1,6 @@
 #include "filter.h"
 #include <math.h>
+#include <string.h>
 
 static void QuatSlerp(q_type from, q_type to, float t, q_type& res)
 {
@@ -50,6 +51,30 @@ static void QuatSlerp(q_type from, q_type to, float t, q_type& res)
     res[3] = scale0 * from[3] + scale1 * to1[3];
 }
 
+/* interval since previous sample, reference interval for the first one */
+double filter_abstract::sample_dt(double t)
+{
+    double dt = t_prev > 0.0 ? t - t_prev : FILTER_REF_DT;
+
+    t_prev = t;
+
+    if (dt < FILTER_MIN_DT)
+        dt = FILTER_MIN_DT;
+    if (dt > FILTER_MAX_DT)
+        dt = FILTER_MAX_DT;
+
+    return dt;
+}
+
+/* convert smoothing factor specified for reference interval to interval dt */
+double filter_abstract::alpha_dt(double alpha, double dt)
+{
+    if (alpha >= 1.0)
+        return 1.0;
+    if (alpha <= 0.0)
+        return 0.0;
+    return 1.0 - pow(1.0 - alpha, dt / FILTER_REF_DT);
+}
 
 filter_median::filter_median(int sz)
 {
@@ -57,7 +82,7 @@ filter_median::filter_median(int sz)
     samples = 0;
 }
 
-void filter_median::process_data(q_vec_type& pos, q_type& rot)
+void filter_median::process_data(q_vec_type& pos, q_type& rot, double t)
 {
 
 }
@@ -68,7 +93,7 @@ filter_avg::filter_avg(int sz)
     samples = 0;
 }
 
-void filter_avg::process_data(q_vec_type& pos, q_type& rot)
+void filter_avg::process_data(q_vec_type& pos, q_type& rot, double t)
 {
     int i, j;
     q_vec_type tmp;
@@ -101,12 +126,14 @@ filter_exp1::filter_exp1(double a_pos, double a_rot)
     samples = 0;
 }
 
-void filter_exp1::process_data(q_vec_type& pos, q_type& rot_quat)
+void filter_exp1::process_data(q_vec_type& pos, q_type& rot_quat, double t)
 {
     int i;
     q_vec_type pos_tmp;
     q_type rot_tmp;
 
+    double dt = sample_dt(t), a_pos, a_rot;
+
     if (!samples)
     {
         samples++;
@@ -115,12 +142,15 @@ void filter_exp1::process_data(q_vec_type& pos, q_type& rot_quat)
         return;
     }
 
+    a_pos = alpha_dt(alpha_pos, dt);
+    a_rot = alpha_dt(alpha_rot, dt);
+
     for (i = 0; i < 3; i++)
-        pos_tmp[i] = alpha_pos * pos[i] + (1.0 - alpha_pos) * pos_prev[i];
+        pos_tmp[i] = a_pos * pos[i] + (1.0 - a_pos) * pos_prev[i];
     q_vec_copy(pos, pos_tmp);
     q_vec_copy(pos_prev, pos_tmp);
 
-    QuatSlerp(rot_prev, rot_quat, alpha_rot, rot_tmp);
+    QuatSlerp(rot_prev, rot_quat, a_rot, rot_tmp);
     q_normalize(rot_quat, rot_tmp);
     q_copy(rot_prev, rot_quat);
 }
@@ -132,10 +162,11 @@ filter_kalman::filter_kalman(double _pos_E_est, double _pos_E_mea)
     samples = 0;
 }
 
-void filter_kalman::process_data(q_vec_type& pos, q_type& rot_quat)
+void filter_kalman::process_data(q_vec_type& pos, q_type& rot_quat, double t)
 {
     int i;
     q_vec_type KG, pos_EST;
+    double dt = sample_dt(t);
 
     if (samples == 0)
     {
@@ -146,7 +177,8 @@ void filter_kalman::process_data(q_vec_type& pos, q_type& rot_quat)
 
     for (i = 0; i < 3; i++)
     {
-        KG[i] = pos_E_est[i] / (pos_E_est[i] + pos_E_mea[i]);
+        /* more frequent measurements are trusted less each */
+        KG[i] = pos_E_est[i] / (pos_E_est[i] + pos_E_mea[i] * FILTER_REF_DT / dt);
 
         pos_EST[i] = pos_EST_prev[i] + KG[i] * (pos[i] - pos_EST_prev[i]);
 
@@ -163,10 +195,10 @@ filter_exp1dyn::filter_exp1dyn(double a_pos, double d_pos)
     samples = 0;
 }
 
-void filter_exp1dyn::process_data(q_vec_type& pos, q_type& rot_quat)
+void filter_exp1dyn::process_data(q_vec_type& pos, q_type& rot_quat, double t)
 {
     int i;
-    double d, alpha_pos;
+    double d, alpha_pos, dt = sample_dt(t);
     q_vec_type pos_tmp;
 
     if (!samples)
@@ -180,7 +212,10 @@ void filter_exp1dyn::process_data(q_vec_type& pos, q_type& rot_quat)
         d += (pos[i] - pos_prev[i]) * (pos[i] - pos_prev[i]);
     d = sqrt(d);
 
-    alpha_pos = (1 - exp(-k * d));
+    /* distance moved per reference interval */
+    d *= FILTER_REF_DT / dt;
+
+    alpha_pos = alpha_dt(1 - exp(-k * d), dt);
 
     for (i = 0; i < 3; i++)
         pos_tmp[i] = alpha_pos * pos[i] + (1.0 - alpha_pos) * pos_prev[i];
@@ -203,10 +238,10 @@ filter_exp1pasha::filter_exp1pasha(double a, double b)
     samples = 0;
 }
 
-void filter_exp1pasha::process_data(q_vec_type& pos, q_type& rot_quat)
+void filter_exp1pasha::process_data(q_vec_type& pos, q_type& rot_quat, double t)
 {
     int i;
-    double d, alpha_pos;
+    double b, dt = sample_dt(t);
     q_vec_type pos_tmp;
 
     if (!samples)
@@ -216,14 +251,18 @@ void filter_exp1pasha::process_data(q_vec_type& pos, q_type& rot_quat)
         return;
     }
 
+    b = alpha_dt(betta, dt);
+
     for (i = 0; i < 3; i++)
     {
-        double t;
-        pos_tmp[i] = alpha[i] * pos[i] + (1.0 - alpha[i]) * pos_prev[i];
+        double e, a = alpha_dt(alpha[i], dt);
+
+        pos_tmp[i] = a * pos[i] + (1.0 - a) * pos_prev[i];
 
-        t = fabs(pos[i] - pos_tmp[i]);
+        /* error per reference interval */
+        e = fabs(pos[i] - pos_tmp[i]) * FILTER_REF_DT / dt;
 
-        alpha[i] = betta * t + (1 - betta) * alpha[i];
+        alpha[i] = b * e + (1 - b) * alpha[i];
 //        alpha[i] *= 0.01;
     };
 
@@ -231,3 +270,179 @@ void filter_exp1pasha::process_data(q_vec_type& pos, q_type& rot_quat)
     q_vec_copy(pos_prev, pos_tmp);
 }
 
+/* rotation vector (axis * angle, radians) of unit quaternion */
+static void quat_to_rotvec(const q_type q, q_vec_type& rv)
+{
+    double s = sqrt(q[Q_X] * q[Q_X] + q[Q_Y] * q[Q_Y] + q[Q_Z] * q[Q_Z]), w = q[Q_W], k;
+
+    if (s < 1e-12)
+    {
+        rv[0] = rv[1] = rv[2] = 0.0;
+        return;
+    }
+
+    /* shortest way */
+    if (w < 0.0)
+    {
+        s = -s;
+        w = -w;
+    }
+    k = 2.0 * atan2(fabs(s), w) / s;
+    rv[0] = q[Q_X] * k;
+    rv[1] = q[Q_Y] * k;
+    rv[2] = q[Q_Z] * k;
+}
+
+static void quat_from_rotvec(q_type& q, const q_vec_type rv)
+{
+    double a = sqrt(rv[0] * rv[0] + rv[1] * rv[1] + rv[2] * rv[2]), k;
+
+    k = a < 1e-12 ? 0.5 : sin(a / 2.0) / a;
+    q[Q_X] = rv[0] * k;
+    q[Q_Y] = rv[1] * k;
+    q[Q_Z] = rv[2] * k;
+    q[Q_W] = cos(a / 2.0);
+}
+
+filter_gate::filter_gate(double lim_pos, double lim_rot, bool acceleration)
+{
+    acc = acceleration;
+    limit_pos = lim_pos;
+    limit_rot = lim_rot * Q_PI / 180.0;
+    held = 0.0;
+    rejected = reseeded = 0;
+    samples = 0;
+}
+
+long filter_gate::getRejected()
+{
+    return rejected;
+}
+
+long filter_gate::getReseeded()
+{
+    return reseeded;
+}
+
+/* constant velocity continuation of last output */
+void filter_gate::predict(q_vec_type& pos, q_type& rot, double dt)
+{
+    q_vec_type rv;
+    q_type dq;
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        pos[i] = pos_prev[i] + vel[i] * dt;
+        rv[i] = avel[i] * dt;
+    }
+    quat_from_rotvec(dq, rv);
+    q_mult(rot, dq, rot_prev);
+    q_normalize(rot, rot);
+}
+
+void filter_gate::process_data(q_vec_type& pos, q_type& rot, double t)
+{
+    int i;
+    double dt = sample_dt(t), a, v_pos, v_rot;
+    q_vec_type v, w, rv;
+    q_type inv, dq;
+
+    if (!samples)
+    {
+        samples++;
+        q_vec_copy(pos_prev, pos);
+        q_copy(rot_prev, rot);
+        vel[0] = vel[1] = vel[2] = 0.0;
+        avel[0] = avel[1] = avel[2] = 0.0;
+        return;
+    }
+
+    /* velocities implied by sample against last output */
+    q_invert(inv, rot_prev);
+    q_mult(dq, rot, inv);
+    quat_to_rotvec(dq, rv);
+    for (i = 0; i < 3; i++)
+    {
+        v[i] = (pos[i] - pos_prev[i]) / dt;
+        w[i] = rv[i] / dt;
+    }
+
+    /* velocity, or its deviation from recent average scaled to acceleration */
+    if (acc)
+    {
+        q_vec_type dv, dw;
+
+        q_vec_subtract(dv, v, vel);
+        q_vec_subtract(dw, w, avel);
+        v_pos = q_vec_magnitude(dv) / FILTER_GATE_TAU;
+        v_rot = q_vec_magnitude(dw) / FILTER_GATE_TAU;
+    }
+    else
+    {
+        v_pos = q_vec_magnitude(v);
+        v_rot = q_vec_magnitude(w);
+    }
+
+    if ((limit_pos > 0.0 && v_pos > limit_pos) || (limit_rot > 0.0 && v_rot > limit_rot))
+    {
+        held += dt;
+        if (held < FILTER_GATE_HOLD)
+        {
+            rejected++;
+            predict(pos, rot, dt);
+            q_vec_copy(pos_prev, pos);
+            q_copy(rot_prev, rot);
+            return;
+        }
+
+        /* rejected for too long: tracking really jumped, start over from it */
+        reseeded++;
+        held = 0.0;
+        q_vec_copy(pos_prev, pos);
+        q_copy(rot_prev, rot);
+        vel[0] = vel[1] = vel[2] = 0.0;
+        avel[0] = avel[1] = avel[2] = 0.0;
+        return;
+    }
+
+    held = 0.0;
+    a = 1.0 - exp(-dt / FILTER_GATE_TAU);
+    for (i = 0; i < 3; i++)
+    {
+        vel[i] += a * (v[i] - vel[i]);
+        avel[i] += a * (w[i] - avel[i]);
+    }
+    q_vec_copy(pos_prev, pos);
+    q_copy(rot_prev, rot);
+}
+
+filter_abstract* filter_create(const char* type, double a, double b)
+{
+    if (!strcmp(type, "kalman"))
+        return new filter_kalman(a, b);
+    if (!strcmp(type, "exp1"))
+        return new filter_exp1(a, b);
+    if (!strcmp(type, "exp1dyn"))
+        return new filter_exp1dyn(a, b);
+    if (!strcmp(type, "exp1pasha"))
+        return new filter_exp1pasha(a, b);
+    if (!strcmp(type, "gate"))
+        return new filter_gate(a, b, false);
+    if (!strcmp(type, "gate_acc"))
+        return new filter_gate(a, b, true);
+    return NULL;
+}
+
+const char* filter_check(const char* type, double a, double b)
+{
+    if (!strcmp(type, "kalman"))
+        return a > 0.0 && b > 0.0 ? NULL : "estimate and measurement errors should be positive";
+    if (!strcmp(type, "exp1") || !strcmp(type, "exp1pasha"))
+        return a > 0.0 && a <= 1.0 && b > 0.0 && b <= 1.0 ? NULL : "both alphas should be in (0, 1]";
+    if (!strcmp(type, "exp1dyn"))
+        return a > 0.0 && a < 1.0 && b > 0.0 ? NULL : "alpha should be in (0, 1) and distance positive";
+    if (!strcmp(type, "gate") || !strcmp(type, "gate_acc"))
+        return a >= 0.0 && b >= 0.0 ? NULL : "limits should not be negative";
+    return "unknown filter type";
+}
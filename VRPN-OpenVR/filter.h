@@ -2,11 +2,29 @@
 
 #include <quat.h>
 
+/*
+    Filters receive sample time (seconds) with every sample and compute
+    their coefficients from the actual interval between samples, so the
+    same parameters give the same smoothing at any loop rate. Parameters
+    are specified for reference interval FILTER_REF_DT (1 kHz sampling).
+*/
+#define FILTER_REF_DT 0.001
+#define FILTER_MIN_DT 0.00001
+#define FILTER_MAX_DT 0.1
+
 class filter_abstract
 {
     public:
-        filter_abstract() {};
-        virtual void process_data(q_vec_type& pos, q_type& rot) = 0;
+        filter_abstract() : t_prev(0.0) {};
+        virtual void process_data(q_vec_type& pos, q_type& rot, double t) = 0;
+        virtual long getRejected() { return -1; }   // samples replaced by gating filter, -1 - filter does not gate
+
+    protected:
+        double sample_dt(double t);
+        static double alpha_dt(double alpha, double dt);
+
+    private:
+        double t_prev;
 };
 
 #define FILTER_MEDIAN_MAX_WINDOW 1024
@@ -15,7 +33,7 @@ class filter_median : public filter_abstract
 {
 public:
     filter_median(int win_size);
-    virtual void process_data(q_vec_type& pos, q_type& rot);
+    virtual void process_data(q_vec_type& pos, q_type& rot, double t);
 
 private:
     q_vec_type poses[FILTER_MEDIAN_MAX_WINDOW];
@@ -29,7 +47,7 @@ class filter_avg : public filter_abstract
 {
 public:
     filter_avg(int win_size);
-    virtual void process_data(q_vec_type& pos, q_type& rot);
+    virtual void process_data(q_vec_type& pos, q_type& rot, double t);
 
 private:
     q_vec_type poses[FILTER_MEDIAN_MAX_WINDOW];
@@ -41,7 +59,7 @@ class filter_exp1 : public filter_abstract
 {
 public:
     filter_exp1(double a_pos, double a_rot);
-    virtual void process_data(q_vec_type& pos, q_type& rot);
+    virtual void process_data(q_vec_type& pos, q_type& rot, double t);
 private:
     int samples;
     double alpha_pos, alpha_rot;
@@ -53,7 +71,7 @@ class filter_kalman : public filter_abstract
 {
 public:
     filter_kalman(double _pos_E_est, double _pos_E_mea);
-    virtual void process_data(q_vec_type& pos, q_type& rot);
+    virtual void process_data(q_vec_type& pos, q_type& rot, double t);
 private:
     int samples;
     q_vec_type pos_E_est, pos_E_mea, pos_EST_prev;
@@ -63,7 +81,7 @@ class filter_exp1dyn : public filter_abstract
 {
 public:
     filter_exp1dyn(double a_pos, double d_pos);
-    virtual void process_data(q_vec_type& pos, q_type& rot);
+    virtual void process_data(q_vec_type& pos, q_type& rot, double t);
 private:
     int samples;
     double k;
@@ -75,7 +93,7 @@ class filter_exp1pasha : public filter_abstract
 {
 public:
     filter_exp1pasha(double a_pos, double d_pos);
-    virtual void process_data(q_vec_type& pos, q_type& rot);
+    virtual void process_data(q_vec_type& pos, q_type& rot, double t);
 private:
     int samples;
     double betta;
@@ -83,3 +101,38 @@ private:
     q_vec_type rot_prev;
 };
 
+#define FILTER_GATE_TAU     0.01        // seconds, smoothing of velocity used for prediction and acceleration
+#define FILTER_GATE_HOLD    0.05        // seconds of consecutive rejections before gate accepts new position as genuine jump
+
+/*
+    Outlier gate: sample is rejected when velocity (or, with acceleration
+    set, change of velocity against its recent average per FILTER_GATE_TAU)
+    it implies exceeds the limit, and replaced with pose predicted from
+    last output and recent velocity. Accepted samples pass unchanged, so
+    gate adds no latency to valid motion. Limits: meters per second (or
+    m/s^2) and degrees per second (or deg/s^2), zero disables the check.
+*/
+class filter_gate : public filter_abstract
+{
+public:
+    filter_gate(double lim_pos, double lim_rot, bool acceleration);
+    virtual void process_data(q_vec_type& pos, q_type& rot, double t);
+    virtual long getRejected();
+    long getReseeded();
+private:
+    void predict(q_vec_type& pos, q_type& rot, double dt);
+    int samples;
+    bool acc;
+    double limit_pos, limit_rot;        // m/s and rad/s, or per second squared
+    double held;                        // seconds of current rejection run
+    long rejected, reseeded;
+    q_vec_type pos_prev, vel;           // last output, smoothed velocity
+    q_type rot_prev;
+    q_vec_type avel;                    // smoothed angular velocity, rotation vector per second
+};
+
+/* create filter by its command line name: kalman, exp1, exp1dyn, exp1pasha, gate, gate_acc; NULL if unknown */
+filter_abstract* filter_create(const char* type, double a, double b);
+
+/* NULL if filter type is known and its parameters are in range, otherwise reason */
+const char* filter_check(const char* type, double a, double b);
@@ -1,4 +1,13 @@
+#if defined(_WIN32)
 #include <windows.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#endif
 #include <memory>
 #include "vrpn_Server_OpenVR.h"
 
@@ -31,6 +40,112 @@ BOOL WINAPI handleConsoleSignalsWin(DWORD signaltype)
 }
 #endif
 
+#if !defined(_WIN32)
+static void timer_arm(int tfd, int interval)
+{
+    struct itimerspec its;
+
+    // interval 0 means busy loop, timer is left disarmed
+    its.it_interval.tv_sec = interval / 1000;
+    its.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    timerfd_settime(tfd, 0, &its, NULL);
+}
+
+/*
+    Single epoll loop: timerfd gives the tick instead of sleeping, signalfd
+    handles ^C and termination. Calibration keypress is read by the next
+    scheduled tick, stdin does not wake the loop so ticks stay on the
+    timer schedule. VRPN does not expose its connection sockets, they
+    are serviced by connection mainloop every tick, FreeD sockets are send
+    only. Timer is rearmed when server switches between full and idle poll
+    interval, so the tick after wakeup already comes at full rate.
+*/
+
+static int main_loop_epoll()
+{
+    int ep, tfd, sfd, n, i, interval;
+    sigset_t mask;
+    struct epoll_event ev, events[2];
+
+    // SIGINT/SIGTERM are delivered through signalfd
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0 || sfd < 0)
+    {
+        perror("timerfd/signalfd");
+        return -1;
+    }
+
+    interval = server->getPollInterval();
+    timer_arm(tfd, interval);
+
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0)
+    {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.fd = tfd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, tfd, &ev);
+    ev.data.fd = sfd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, sfd, &ev);
+
+    while (!done)
+    {
+        int tick;
+
+        if (interval != server->getPollInterval())
+        {
+            interval = server->getPollInterval();
+            timer_arm(tfd, interval);
+        }
+        tick = interval <= 0;
+
+        n = epoll_wait(ep, events, sizeof(events) / sizeof(events[0]), interval > 0 ? -1 : 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (events[i].data.fd == tfd)
+            {
+                uint64_t expirations;
+                if (read(tfd, &expirations, sizeof(expirations)) > 0)
+                    tick = 1;
+            }
+            else if (events[i].data.fd == sfd)
+            {
+                struct signalfd_siginfo si;
+                if (read(sfd, &si, sizeof(si)) > 0)
+                    done = 1;
+            }
+        }
+
+        if (tick && !done)
+            server->mainloop();
+    }
+
+    close(ep);
+    close(tfd);
+    close(sfd);
+
+    return 0;
+}
+#endif
+
 #define WS_VER_MAJOR 2
 #define WS_VER_MINOR 2
 
@@ -46,10 +161,14 @@ int main(int argc, char *argv[]) {
     );
 #endif
     server = std::make_unique<vrpn_Server_OpenVR>(argc, argv);
+#if defined(_WIN32)
     while (!done) {
         server->mainloop();
-        vrpn_SleepMsecs(server->sleep_interval);
+        vrpn_SleepMsecs(server->getPollInterval());
     }
+#else
+    main_loop_epoll();
+#endif
     server.reset(nullptr);
     return 0;
 }
\ No newline at end of file
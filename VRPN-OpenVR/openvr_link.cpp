@@ -0,0 +1,112 @@
+#include "openvr_link.h"
+#include <chrono>
+#include <stdio.h>
+
+static double steady_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+openvr_link::openvr_link(vr::EVRApplicationType _type) :
+    type(_type), system(nullptr), attempts(0), attaches(0), retry_at(0.0), running(true)
+{
+    thread = std::thread(&openvr_link::worker, this);
+}
+
+openvr_link::~openvr_link()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+
+    if (system.load())
+        vr::VR_Shutdown();
+}
+
+vr::IVRSystem* openvr_link::get()
+{
+    return system.load(std::memory_order_acquire);
+}
+
+void openvr_link::detach()
+{
+    if (!system.load())
+        return;
+
+    vr::VR_Shutdown();
+
+    std::lock_guard<std::mutex> guard(lock);
+    system = nullptr;
+    wake.notify_one();
+}
+
+long openvr_link::getAttempts()
+{
+    return attempts;
+}
+
+long openvr_link::getAttaches()
+{
+    return attaches;
+}
+
+double openvr_link::getRetryIn()
+{
+    double left = retry_at - steady_now();
+
+    return left > 0.0 ? left : 0.0;
+}
+
+void openvr_link::getError(char* buf, int len)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    snprintf(buf, len, "%s", error.c_str());
+}
+
+void openvr_link::worker()
+{
+    double backoff = OPENVR_RETRY_MIN;
+    std::unique_lock<std::mutex> guard(lock);
+
+    while (running)
+    {
+        /* attached, wait for runtime to quit */
+        if (system.load())
+        {
+            wake.wait(guard);
+            if (!running || system.load())
+                continue;
+
+            /* give quitting runtime time to go away before attaching again */
+            error = "runtime quit";
+            backoff = OPENVR_RETRY_MIN;
+            retry_at = steady_now() + backoff;
+            wake.wait_for(guard, std::chrono::duration<double>(backoff), [this] { return !running; });
+            continue;
+        }
+
+        guard.unlock();
+        vr::EVRInitError eError = vr::VRInitError_None;
+        vr::IVRSystem* s = vr::VR_Init(&eError, type); /// https://github.com/ValveSoftware/openvr/wiki/API-Documentation
+        guard.lock();
+        attempts++;
+
+        if (eError == vr::VRInitError_None && s)
+        {
+            error.clear();
+            attaches++;
+            backoff = OPENVR_RETRY_MIN;
+            system.store(s, std::memory_order_release);
+            continue;
+        }
+
+        error = vr::VR_GetVRInitErrorAsEnglishDescription(eError);
+        retry_at = steady_now() + backoff;
+        wake.wait_for(guard, std::chrono::duration<double>(backoff), [this] { return !running; });
+        backoff = backoff * 2.0 < OPENVR_RETRY_MAX ? backoff * 2.0 : OPENVR_RETRY_MAX;
+    }
+}
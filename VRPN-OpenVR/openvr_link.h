@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <condition_variable>
+#include <openvr.h>
+
+#define OPENVR_RETRY_MIN        0.5     // seconds, first retry after failed attach
+#define OPENVR_RETRY_MAX        10.0    // seconds, backoff limit
+
+/*
+    Attachment to OpenVR runtime: VR_Init is called by background thread,
+    failed attempts are retried with exponential backoff, so server starts
+    and serves VRPN and FreeD without SteamVR. When runtime quits, main loop
+    calls detach() and thread starts attaching again.
+
+    get() and detach() are called by main loop only, runtime is never used
+    by both threads at the same time.
+*/
+class openvr_link
+{
+public:
+    openvr_link(vr::EVRApplicationType type);
+    ~openvr_link();
+    vr::IVRSystem* get();
+    void detach();
+    long getAttempts();
+    long getAttaches();
+    double getRetryIn();
+    void getError(char* buf, int len);
+
+private:
+    void worker();
+
+    vr::EVRApplicationType type;
+    std::atomic<vr::IVRSystem*> system;
+    std::atomic<long> attempts, attaches;
+    std::atomic<double> retry_at;
+    bool running;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::string error;
+    std::thread thread;
+};
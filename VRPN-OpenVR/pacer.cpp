@@ -0,0 +1,426 @@
+#include "pacer.h"
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <ws2tcpip.h>
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#if defined(__linux__)
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <sys/eventfd.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
+#endif
+
+static double wall_now()
+{
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static bool due_later(const paced_packet_t& a, const paced_packet_t& b)
+{
+    return a.when > b.when;
+}
+
+packet_pacer::packet_pacer() :
+    head(0), tail(0), sent(0), errors(0), late(0), overflows(0), lateness_max(0.0), running(true), sleeping(false)
+{
+    queue.resize(PACER_QUEUE);
+    heap.reserve(PACER_QUEUE);
+#if defined(_WIN32)
+    wake_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+#elif defined(__linux__)
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    wake_fd = -1;
+#endif
+    thread = std::thread(&packet_pacer::worker, this);
+}
+
+packet_pacer::~packet_pacer()
+{
+    running = false;
+    wakeWorker();
+    thread.join();
+#if defined(_WIN32)
+    CloseHandle(wake_event);
+#else
+    if (wake_fd >= 0)
+        close(wake_fd);
+#endif
+}
+
+void packet_pacer::wakeWorker()
+{
+#if defined(_WIN32)
+    SetEvent(wake_event);
+#else
+    uint64_t one = 1;
+    if (wake_fd >= 0 && write(wake_fd, &one, sizeof(one)) < 0)
+        return;
+#endif
+}
+
+/* sleep until timeout or wakeWorker(), whichever comes first */
+void packet_pacer::waitWake(double seconds)
+{
+#if defined(_WIN32)
+    WaitForSingleObject(wake_event, (DWORD)(seconds * 1000.0));
+#else
+    if (wake_fd < 0)
+    {
+        /* no eventfd: nap in short steps, producer never waits anyway */
+        std::this_thread::sleep_for(std::chrono::duration<double>(std::min(seconds, 0.001)));
+        return;
+    }
+
+    struct pollfd pfd = { wake_fd, POLLIN, 0 };
+    uint64_t cnt;
+#if defined(__linux__)
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1000000000.0);
+    if (ppoll(&pfd, 1, &ts, NULL) > 0 && read(wake_fd, &cnt, sizeof(cnt)) < 0)
+        return;
+#else
+    if (poll(&pfd, 1, (int)(seconds * 1000.0)) > 0 && read(wake_fd, &cnt, sizeof(cnt)) < 0)
+        return;
+#endif
+#endif
+}
+
+/* queue datagram, called by main loop only, never blocks; sent immediately if queue is full */
+bool packet_pacer::send(int sock, const struct sockaddr_in* addr, const unsigned char* buf, int len, double when)
+{
+    uint32_t h = head.load(std::memory_order_relaxed);
+
+    if (len > PACER_PACKET_MAX || h - tail.load(std::memory_order_acquire) >= PACER_QUEUE)
+    {
+        overflows++;
+        if (sendto(sock, (const char*)buf, len, 0, (const struct sockaddr *)addr, sizeof(struct sockaddr_in)) < 0)
+        {
+            errors++;
+            return false;
+        }
+        sent++;
+        return true;
+    }
+
+    paced_packet_t* p = &queue[h & (PACER_QUEUE - 1)];
+    p->when = when;
+    p->sock = sock;
+    p->addr = *addr;
+    p->len = len;
+    memcpy(p->buf, buf, len);
+
+    /* pacer sleeping until later packet or idle has to recheck ring, seq_cst
+       pairs with its announce: either it sees new head or we see it sleeping */
+    head.store(h + 1, std::memory_order_seq_cst);
+    if (sleeping.exchange(false, std::memory_order_seq_cst))
+        wakeWorker();
+
+    return true;
+}
+
+long packet_pacer::getSent()
+{
+    return sent;
+}
+
+long packet_pacer::getErrors()
+{
+    return errors;
+}
+
+long packet_pacer::getLate()
+{
+    return late;
+}
+
+long packet_pacer::getOverflows()
+{
+    return overflows;
+}
+
+double packet_pacer::getLatenessMax()
+{
+    return lateness_max;
+}
+
+void packet_pacer::worker()
+{
+    while (running)
+    {
+        /* move queued packets to heap ordered by due time, heap never grows
+           over its reservation, rest stays in ring */
+        uint32_t t = tail.load(std::memory_order_relaxed), h = head.load(std::memory_order_acquire);
+        for (; t != h && heap.size() < PACER_QUEUE; t++)
+        {
+            heap.push_back(queue[t & (PACER_QUEUE - 1)]);
+            std::push_heap(heap.begin(), heap.end(), due_later);
+        }
+        tail.store(t, std::memory_order_release);
+
+        double left = heap.empty() ? PACER_IDLE : heap.front().when - wall_now();
+        if (left > PACER_SPIN)
+        {
+            /* announce sleep, then recheck ring so packet queued meanwhile is not missed */
+            sleeping.store(true, std::memory_order_seq_cst);
+            if (head.load(std::memory_order_seq_cst) == t || heap.size() >= PACER_QUEUE)
+                waitWake(left - PACER_SPIN);
+            sleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        /* spin rest of time, yielding to main loop, then send everything due */
+        while (heap.front().when > wall_now())
+            std::this_thread::yield();
+        for (double now = wall_now(); !heap.empty() && heap.front().when <= now;)
+        {
+            paced_packet_t* p = &heap.front();
+            double lateness = now - p->when;
+
+            if (sendto(p->sock, (const char*)p->buf, p->len, 0, (struct sockaddr *)&p->addr, sizeof(struct sockaddr_in)) < 0)
+                errors++;
+            else
+                sent++;
+            if (lateness > PACER_LATE)
+                late++;
+            if (lateness > lateness_max)
+                lateness_max = lateness;
+
+            std::pop_heap(heap.begin(), heap.end(), due_later);
+            heap.pop_back();
+        }
+    }
+}
+
+int packet_pacer::txtimeFind(const char* name)
+{
+    if (!strcmp(name, "etf"))
+        return PACER_TXTIME_ETF;
+    if (!strcmp(name, "fq"))
+        return PACER_TXTIME_FQ;
+    if (!strcmp(name, "0") || !strcmp(name, "none"))
+        return PACER_TXTIME_NONE;
+    return -1;
+}
+
+#if defined(__linux__) && defined(SO_TXTIME)
+
+/* interface datagrams to target leave through, 0 if unknown */
+static int txtime_ifindex(const struct sockaddr_in* target)
+{
+    struct sockaddr_in local;
+    socklen_t local_len = sizeof(local);
+    struct ifaddrs *ifa, *i;
+    int idx = 0, sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock < 0)
+        return 0;
+    if (connect(sock, (const struct sockaddr*)target, sizeof(*target)) || getsockname(sock, (struct sockaddr*)&local, &local_len))
+    {
+        close(sock);
+        return 0;
+    }
+    close(sock);
+
+    if (getifaddrs(&ifa))
+        return 0;
+    for (i = ifa; i && !idx; i = i->ifa_next)
+        if (i->ifa_addr && i->ifa_addr->sa_family == AF_INET &&
+            ((struct sockaddr_in*)i->ifa_addr)->sin_addr.s_addr == local.sin_addr.s_addr)
+            idx = (int)if_nametoindex(i->ifa_name);
+    freeifaddrs(ifa);
+
+    return idx;
+}
+
+/* qdisc of given kind is attached to interface, root or child, by RTM_GETQDISC dump */
+static bool txtime_qdisc(int ifindex, const char* kind)
+{
+    struct
+    {
+        struct nlmsghdr nh;
+        struct tcmsg tc;
+    } req;
+    char buf[16384];
+    bool found = false, done = false;
+    int sock = (int)socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+
+    if (sock < 0)
+        return false;
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+    req.nh.nlmsg_type = RTM_GETQDISC;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.tc.tcm_family = AF_UNSPEC;
+    if (send(sock, &req, req.nh.nlmsg_len, 0) < 0)
+    {
+        close(sock);
+        return false;
+    }
+
+    while (!done)
+    {
+        int len = (int)recv(sock, buf, sizeof(buf), 0);
+        struct nlmsghdr* nh;
+
+        if (len <= 0)
+            break;
+
+        for (nh = (struct nlmsghdr*)buf; NLMSG_OK(nh, (unsigned int)len); nh = NLMSG_NEXT(nh, len))
+        {
+            if (nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR)
+            {
+                done = true;
+                break;
+            }
+
+            struct tcmsg* tc = (struct tcmsg*)NLMSG_DATA(nh);
+            if (nh->nlmsg_type != RTM_NEWQDISC || tc->tcm_ifindex != ifindex)
+                continue;
+
+            int alen = (int)(nh->nlmsg_len - NLMSG_LENGTH(sizeof(*tc)));
+            for (struct rtattr* a = (struct rtattr*)((char*)tc + NLMSG_ALIGN(sizeof(*tc))); RTA_OK(a, alen); a = RTA_NEXT(a, alen))
+                if (a->rta_type == TCA_KIND && !strcmp((const char*)RTA_DATA(a), kind))
+                    found = true;
+        }
+    }
+
+    close(sock);
+
+    return found;
+}
+
+#endif
+
+/*
+    UDP socket with SO_TXTIME enabled, -1 if kernel pacing can not be
+    confirmed: option is not supported or egress interface of target has
+    no etf (fq) qdisc, which would send stamped datagrams at once. Dropped
+    datagrams (missed or invalid transmit time) are reported to socket
+    error queue, see txtimeDropped().
+*/
+int packet_pacer::txtimeOpen(int mode, const struct sockaddr_in* target)
+{
+#if defined(__linux__) && defined(SO_TXTIME)
+    struct sock_txtime cfg;
+    int sock, ifindex = txtime_ifindex(target);
+
+    if (!ifindex || !txtime_qdisc(ifindex, mode == PACER_TXTIME_ETF ? "etf" : "fq"))
+        return -1;
+
+    sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+        return -1;
+
+    cfg.clockid = mode == PACER_TXTIME_ETF ? CLOCK_TAI : CLOCK_MONOTONIC;
+    cfg.flags = SOF_TXTIME_REPORT_ERRORS;
+    if (setsockopt(sock, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)))
+    {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+#else
+    (void)mode;
+    (void)target;
+    return -1;
+#endif
+}
+
+/* datagrams qdisc dropped since last call, drained from socket error queue */
+int packet_pacer::txtimeDropped(int sock)
+{
+#if defined(__linux__) && defined(SO_TXTIME)
+    int dropped = 0;
+
+    while (1)
+    {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+        unsigned char data[PACER_PACKET_MAX];
+        struct msghdr msg;
+        struct iovec iov;
+        struct cmsghdr *cm;
+
+        iov.iov_base = data;
+        iov.iov_len = sizeof(data);
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
+
+        for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            struct sock_extended_err err;
+
+            if (cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR)
+                continue;
+            memcpy(&err, CMSG_DATA(cm), sizeof(err));
+            if (err.ee_origin == SO_EE_ORIGIN_TXTIME)
+                dropped++;
+        }
+    }
+
+    return dropped;
+#else
+    (void)sock;
+    return 0;
+#endif
+}
+
+/* send datagram stamped with transmit time, qdisc holds it until then */
+int packet_pacer::txtimeSend(int sock, int mode, const struct sockaddr_in* addr, const unsigned char* buf, int len, double when)
+{
+#if defined(__linux__) && defined(SO_TXTIME)
+    char control[CMSG_SPACE(sizeof(uint64_t))];
+    struct timespec ts, wall;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cm;
+    uint64_t txtime;
+
+    /* due time is wall clock, qdisc clock is TAI or monotonic */
+    clock_gettime(mode == PACER_TXTIME_ETF ? CLOCK_TAI : CLOCK_MONOTONIC, &ts);
+    clock_gettime(CLOCK_REALTIME, &wall);
+    txtime = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec +
+        (int64_t)((when - (wall.tv_sec + wall.tv_nsec / 1000000000.0)) * 1000000000.0);
+
+    iov.iov_base = (void*)buf;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = (void*)addr;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_TXTIME;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+    memcpy(CMSG_DATA(cm), &txtime, sizeof(txtime));
+
+    return (int)sendmsg(sock, &msg, 0);
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+
+#define PACER_QUEUE         1024        // packets in ring and in heap each, power of 2
+#define PACER_PACKET_MAX    64          // bytes, FreeD D1 is 29
+#define PACER_SPIN          0.0002      // seconds before due time pacer stops sleeping and spins
+#define PACER_LATE          0.0001      // seconds after due time packet is counted as late
+#define PACER_IDLE          0.1         // seconds pacer sleeps with nothing queued
+
+/* kernel transmit time modes of SO_TXTIME socket */
+#define PACER_TXTIME_NONE   0
+#define PACER_TXTIME_ETF    1           // CLOCK_TAI, for ETF qdisc
+#define PACER_TXTIME_FQ     2           // CLOCK_MONOTONIC, for fq qdisc
+
+typedef struct
+{
+    double when;                        // due time, seconds since epoch
+    int sock;
+    struct sockaddr_in addr;
+    int len;
+    unsigned char buf[PACER_PACKET_MAX];
+} paced_packet_t;
+
+/*
+    Userspace pacing: main loop queues datagram with its transmit time, pacer
+    thread sleeps until shortly before the earliest due time, spins the rest
+    and sends it. Queue is single producer lock-free ring, pacer orders
+    packets in preallocated heap of the same size, so queueing does not
+    allocate. Main loop never takes a lock: it wakes pacer through eventfd
+    (event on Windows) only when pacer announced it goes to sleep, so
+    realtime main loop is not blocked by lower priority pacer. When heap is
+    full pacer stops taking packets from ring, full ring is sent immediately
+    and counted as overflow.
+
+    When kernel supports SO_TXTIME (Linux 4.19+) datagram can be stamped with
+    transmit time instead and held by ETF or fq qdisc, see txtimeOpen() and
+    txtimeSend(). Socket option alone does not prove pacing, qdisc that
+    ignores transmit time sends at once, so kernel pacing is used only when
+    matching qdisc is found on egress interface.
+*/
+class packet_pacer
+{
+public:
+    packet_pacer();
+    ~packet_pacer();
+    bool send(int sock, const struct sockaddr_in* addr, const unsigned char* buf, int len, double when);
+    long getSent();
+    long getErrors();
+    long getLate();
+    long getOverflows();
+    double getLatenessMax();
+
+    static int txtimeOpen(int mode, const struct sockaddr_in* target);
+    static int txtimeSend(int sock, int mode, const struct sockaddr_in* addr, const unsigned char* buf, int len, double when);
+    static int txtimeDropped(int sock);
+    static int txtimeFind(const char* name);
+
+private:
+    void worker();
+    void wakeWorker();
+    void waitWake(double seconds);
+
+    std::vector<paced_packet_t> queue;
+    std::atomic<uint32_t> head, tail;
+    std::vector<paced_packet_t> heap;
+    std::atomic<long> sent, errors, late, overflows;
+    std::atomic<double> lateness_max;
+    std::atomic<bool> running, sleeping;
+#if defined(_WIN32)
+    HANDLE wake_event;
+#else
+    int wake_fd;                        // eventfd, -1 where missing: pacer naps instead
+#endif
+    std::thread thread;
+};
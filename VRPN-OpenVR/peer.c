@@ -0,0 +1,156 @@
+#include <string.h>
+#include <errno.h>
+
+#include "peer.h"
+
+static void pack_be32(unsigned char *buf, uint32_t v)
+{
+    buf[0] = (v >> 24) & 0xFF;
+    buf[1] = (v >> 16) & 0xFF;
+    buf[2] = (v >> 8) & 0xFF;
+    buf[3] = v & 0xFF;
+}
+
+static uint32_t unpack_be32(unsigned char *buf)
+{
+    return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) | ((uint32_t)buf[2] << 8) | buf[3];
+}
+
+static void pack_be64(unsigned char *buf, uint64_t v)
+{
+    pack_be32(buf, (uint32_t)(v >> 32));
+    pack_be32(buf + 4, (uint32_t)v);
+}
+
+static uint64_t unpack_be64(unsigned char *buf)
+{
+    return ((uint64_t)unpack_be32(buf) << 32) | unpack_be32(buf + 4);
+}
+
+static void pack_double(unsigned char *buf, double d)
+{
+    uint64_t v;
+    memcpy(&v, &d, sizeof(v));
+    pack_be64(buf, v);
+}
+
+static double unpack_double(unsigned char *buf)
+{
+    double d;
+    uint64_t v = unpack_be64(buf);
+    memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+static void pack_float(unsigned char *buf, double d)
+{
+    uint32_t v;
+    float f = (float)d;
+    memcpy(&v, &f, sizeof(v));
+    pack_be32(buf, v);
+}
+
+static double unpack_float(unsigned char *buf)
+{
+    float f;
+    uint32_t v = unpack_be32(buf);
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+void peer_i64_pack(unsigned char *buf, int64_t v)
+{
+    pack_be64(buf, (uint64_t)v);
+}
+
+int64_t peer_i64_unpack(unsigned char *buf)
+{
+    return (int64_t)unpack_be64(buf);
+}
+
+int peer_header_pack(unsigned char *buf, int len, peer_header_t* src)
+{
+    if (len < PEER_HEADER_SIZE)
+        return -EINVAL;
+
+    pack_be32(buf, PEER_MAGIC);
+    buf[4] = PEER_VERSION;
+    buf[5] = src->type;
+    buf[6] = src->count;
+    buf[7] = 0;
+    pack_be32(buf + 8, src->node);
+    pack_be32(buf + 12, src->seq);
+    pack_be64(buf + 16, (uint64_t)src->t_send);
+
+    return 0;
+}
+
+int peer_header_unpack(unsigned char *buf, int len, peer_header_t* dst)
+{
+    memset(dst, 0, sizeof(*dst));
+
+    if (len < PEER_HEADER_SIZE)
+        return -EINVAL;
+
+    if (unpack_be32(buf) != PEER_MAGIC || buf[4] != PEER_VERSION)
+        return -EFAULT;
+
+    dst->type = buf[5];
+    dst->count = buf[6];
+    dst->node = unpack_be32(buf + 8);
+    dst->seq = unpack_be32(buf + 12);
+    dst->t_send = (int64_t)unpack_be64(buf + 16);
+
+    if (dst->type == PEER_TYPE_POSES && (dst->count > PEER_MAX_POSES || len < PEER_HEADER_SIZE + dst->count * PEER_POSE_SIZE))
+        return -EINVAL;
+
+    return 0;
+}
+
+int peer_pose_pack(unsigned char *buf, int len, peer_pose_t* src)
+{
+    int i;
+
+    if (len < PEER_POSE_SIZE)
+        return -EINVAL;
+
+    memset(buf, 0, PEER_SERIAL_LEN);
+    strncpy((char*)buf, src->serial, PEER_SERIAL_LEN - 1);
+    buf[32] = src->device_class;
+    buf[33] = src->tracking;
+    buf[34] = src->valid ? 1 : 0;
+    buf[35] = 0;
+
+    for (i = 0; i < 3; i++)
+        pack_double(buf + 36 + i * 8, src->pos[i]);
+    for (i = 0; i < 4; i++)
+        pack_float(buf + 60 + i * 4, src->quat[i]);
+
+    pack_be64(buf + 76, (uint64_t)src->timestamp);
+
+    return 0;
+}
+
+int peer_pose_unpack(unsigned char *buf, int len, peer_pose_t* dst)
+{
+    int i;
+
+    memset(dst, 0, sizeof(*dst));
+
+    if (len < PEER_POSE_SIZE)
+        return -EINVAL;
+
+    memcpy(dst->serial, buf, PEER_SERIAL_LEN - 1);
+    dst->device_class = buf[32];
+    dst->tracking = buf[33];
+    dst->valid = buf[34];
+
+    for (i = 0; i < 3; i++)
+        dst->pos[i] = unpack_double(buf + 36 + i * 8);
+    for (i = 0; i < 4; i++)
+        dst->quat[i] = unpack_float(buf + 60 + i * 4);
+
+    dst->timestamp = (int64_t)unpack_be64(buf + 76);
+
+    return 0;
+}
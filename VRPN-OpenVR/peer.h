@@ -0,0 +1,85 @@
+#ifndef peer_h
+#define peer_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/*
+    Peer protocol: instances forward device poses to an aggregator over UDP.
+    All fields are big endian.
+
+    Header (24 bytes):
+
+        0   magic 'VFOP'
+        4   version
+        5   type: PEER_TYPE_POSES, PEER_TYPE_PING, PEER_TYPE_PONG
+        6   poses count (PEER_TYPE_POSES)
+        7   reserved
+        8   node id of sender
+        12  sequence number, incremented for every packet of a type
+        16  send time, microseconds of sender clock
+
+    PEER_TYPE_POSES payload is count of pose records (84 bytes each):
+
+        0   serial, zero padded
+        32  device class (vr::ETrackedDeviceClass)
+        33  tracking result (vr::ETrackingResult)
+        34  pose is valid
+        35  reserved
+        36  position, 3 x double, meters
+        60  rotation, 4 x float, q_type order
+        76  sample time, microseconds of sender clock
+
+    PEER_TYPE_PING is sent by aggregator, payload is its send time t1 (8 bytes).
+    PEER_TYPE_PONG echoes t1 and adds receive time of ping t2 (16 bytes), its
+    own send time in header is t3.
+*/
+
+#define PEER_MAGIC          0x56464F50  /* "VFOP" */
+#define PEER_VERSION        1
+#define PEER_TYPE_POSES     1
+#define PEER_TYPE_PING      2
+#define PEER_TYPE_PONG      3
+#define PEER_HEADER_SIZE    24
+#define PEER_POSE_SIZE      84
+#define PEER_SERIAL_LEN     32
+#define PEER_MAX_POSES      16
+#define PEER_PACKET_MAX     (PEER_HEADER_SIZE + PEER_MAX_POSES * PEER_POSE_SIZE)
+
+typedef struct
+{
+    int type;
+    int count;
+    uint32_t node;
+    uint32_t seq;
+    int64_t t_send;
+} peer_header_t;
+
+typedef struct
+{
+    char serial[PEER_SERIAL_LEN];
+    int device_class;
+    int tracking;
+    int valid;
+    double pos[3];
+    double quat[4];
+    int64_t timestamp;
+    uint32_t node;          // sender node, not packed, set by receiver
+} peer_pose_t;
+
+int peer_header_pack(unsigned char *buf, int len, peer_header_t* src);
+int peer_header_unpack(unsigned char *buf, int len, peer_header_t* dst);
+int peer_pose_pack(unsigned char *buf, int len, peer_pose_t* src);
+int peer_pose_unpack(unsigned char *buf, int len, peer_pose_t* dst);
+void peer_i64_pack(unsigned char *buf, int64_t v);
+int64_t peer_i64_unpack(unsigned char *buf);
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif /* peer_h */
@@ -0,0 +1,336 @@
+#include "peer_link.h"
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+
+#if defined(_WIN32)
+#include <ws2tcpip.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#define closesocket close
+#endif
+
+static int peer_socket()
+{
+    int sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock < 0)
+        return -1;
+
+#if defined(_WIN32)
+    u_long nb = 1;
+    ioctlsocket(sock, FIONBIO, &nb);
+#else
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+#endif
+
+    return sock;
+}
+
+/*
+    Clock pings are stamped at the actual receive and send, tick timestamp
+    of poll() can be a whole tick off and would bias offset and round trip.
+    Same wall clock as vrpn_gettimeofday of the tick.
+*/
+static int64_t peer_clock()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// -------------------------------------------------------------------------------------
+
+peer_sender::peer_sender(uint32_t _node, const char* _target) :
+    sock(-1), node(_node), seq_poses(0), seq_pong(0), clock_offset(0), target(_target)
+{
+    char *port, *host = strdup(_target);
+
+    memset(&addr, 0, sizeof(addr));
+
+    port = strrchr(host, ':');
+    if (port)
+    {
+        *port = 0; port++;
+
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(host);
+        addr.sin_port = htons((unsigned short)atoi(port));
+
+        sock = peer_socket();
+        if (sock < 0)
+            std::cerr << "Failed to create peer socket" << std::endl;
+    }
+    else
+        std::cerr << "Failed to parse peer target [" << _target << "], should be host:port" << std::endl;
+
+    free(host);
+}
+
+peer_sender::~peer_sender()
+{
+    if (sock >= 0)
+        closesocket(sock);
+}
+
+bool peer_sender::isOpen()
+{
+    return sock >= 0;
+}
+
+const std::string& peer_sender::getTarget()
+{
+    return target;
+}
+
+uint32_t peer_sender::getNode()
+{
+    return node;
+}
+
+void peer_sender::send(const peer_pose_t* poses, int count, int64_t now)
+{
+    unsigned char buf[PEER_PACKET_MAX];
+
+    if (sock < 0)
+        return;
+
+    do
+    {
+        int i;
+        peer_header_t hdr;
+
+        hdr.type = PEER_TYPE_POSES;
+        hdr.count = count > PEER_MAX_POSES ? PEER_MAX_POSES : count;
+        hdr.node = node;
+        hdr.seq = seq_poses++;
+        hdr.t_send = now;
+        peer_header_pack(buf, sizeof(buf), &hdr);
+
+        for (i = 0; i < hdr.count; i++)
+            peer_pose_pack(buf + PEER_HEADER_SIZE + i * PEER_POSE_SIZE, PEER_POSE_SIZE, (peer_pose_t*)&poses[i]);
+
+        sendto(sock, (const char*)buf, PEER_HEADER_SIZE + hdr.count * PEER_POSE_SIZE, 0, (struct sockaddr*)&addr, sizeof(addr));
+
+        poses += hdr.count;
+        count -= hdr.count;
+    } while (count > 0);
+}
+
+// shift clock of this peer, synthetic peers use it to exercise offset estimate
+void peer_sender::setClockOffset(int64_t us)
+{
+    clock_offset = us;
+}
+
+void peer_sender::poll()
+{
+    int r;
+    unsigned char buf[PEER_PACKET_MAX];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+
+    if (sock < 0)
+        return;
+
+    while ((r = recvfrom(sock, (char*)buf, sizeof(buf), 0, (struct sockaddr*)&from, &from_len)) > 0)
+    {
+        peer_header_t hdr;
+        unsigned char reply[PEER_HEADER_SIZE + 16];
+        int64_t t2 = peer_clock() + clock_offset;
+
+        if (peer_header_unpack(buf, r, &hdr) || hdr.type != PEER_TYPE_PING || r < PEER_HEADER_SIZE + 8)
+            continue;
+
+        /* t1 of aggregator, t2 at receive, t3 at send */
+        memcpy(reply + PEER_HEADER_SIZE, buf + PEER_HEADER_SIZE, 8);
+        peer_i64_pack(reply + PEER_HEADER_SIZE + 8, t2);
+        hdr.type = PEER_TYPE_PONG;
+        hdr.count = 0;
+        hdr.node = node;
+        hdr.seq = seq_pong++;
+        hdr.t_send = peer_clock() + clock_offset;
+        peer_header_pack(reply, sizeof(reply), &hdr);
+
+        sendto(sock, (const char*)reply, sizeof(reply), 0, (struct sockaddr*)&from, from_len);
+        from_len = sizeof(from);
+    }
+}
+
+// -------------------------------------------------------------------------------------
+
+peer_aggregator::peer_aggregator(int _port) : sock(-1), port(_port), seq_ping(0)
+{
+    struct sockaddr_in addr;
+
+    sock = peer_socket();
+    if (sock < 0)
+    {
+        std::cerr << "Failed to create peer socket" << std::endl;
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((unsigned short)port);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)))
+    {
+        std::cerr << "Failed to bind peer UDP port " << port << std::endl;
+        closesocket(sock);
+        sock = -1;
+    }
+}
+
+peer_aggregator::~peer_aggregator()
+{
+    if (sock >= 0)
+        closesocket(sock);
+}
+
+bool peer_aggregator::isOpen()
+{
+    return sock >= 0;
+}
+
+int peer_aggregator::getPort()
+{
+    return port;
+}
+
+const std::map<uint32_t, peer_stat_t>& peer_aggregator::getPeers()
+{
+    return peers;
+}
+
+void peer_aggregator::ping(peer_stat_t* st, int64_t now)
+{
+    peer_header_t hdr;
+    unsigned char buf[PEER_HEADER_SIZE + 8];
+
+    hdr.type = PEER_TYPE_PING;
+    hdr.count = 0;
+    hdr.node = 0;
+    hdr.seq = seq_ping++;
+    hdr.t_send = peer_clock();
+    peer_header_pack(buf, sizeof(buf), &hdr);
+    peer_i64_pack(buf + PEER_HEADER_SIZE, hdr.t_send);
+
+    sendto(sock, (const char*)buf, sizeof(buf), 0, (struct sockaddr*)&st->sa, sizeof(st->sa));
+
+    st->last_ping = now;
+}
+
+/*
+    NTP style estimate: offset = ((t2 - t1) + (t3 - t4)) / 2, sample with
+    lowest round trip of recent window is least disturbed by queuing.
+*/
+void peer_aggregator::pong(peer_stat_t* st, unsigned char* buf, int len, peer_header_t* hdr, int64_t rx)
+{
+    int i, best;
+    int64_t t1, t2, t3 = hdr->t_send, t4 = rx;
+
+    if (len < PEER_HEADER_SIZE + 16)
+        return;
+
+    t1 = peer_i64_unpack(buf + PEER_HEADER_SIZE);
+    t2 = peer_i64_unpack(buf + PEER_HEADER_SIZE + 8);
+
+    i = st->samples++ % PEER_PING_WINDOW;
+    st->sample_offset[i] = ((t2 - t1) + (t3 - t4)) / 2;
+    st->sample_rtt[i] = (t4 - t1) - (t3 - t2);
+
+    for (best = 0, i = 1; i < PEER_PING_WINDOW && i < st->samples; i++)
+        if (st->sample_rtt[i] < st->sample_rtt[best])
+            best = i;
+
+    st->offset = st->sample_offset[best];
+    st->rtt = st->sample_rtt[best];
+    st->synced = true;
+}
+
+int peer_aggregator::poll(int64_t now, std::vector<peer_pose_t>& poses)
+{
+    int r, cnt = 0;
+    unsigned char buf[PEER_PACKET_MAX];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+
+    if (sock < 0)
+        return 0;
+
+    while ((r = recvfrom(sock, (char*)buf, sizeof(buf), 0, (struct sockaddr*)&from, &from_len)) > 0)
+    {
+        int i;
+        peer_header_t hdr;
+        peer_stat_t* st;
+        int64_t rx = peer_clock();
+
+        from_len = sizeof(from);
+
+        if (peer_header_unpack(buf, r, &hdr) || (hdr.type != PEER_TYPE_POSES && hdr.type != PEER_TYPE_PONG))
+            continue;
+
+        /* new peer */
+        auto it = peers.find(hdr.node);
+        if (it == peers.end())
+        {
+            peer_stat_t init = {};
+
+            init.node = hdr.node;
+            init.addr = std::string(inet_ntoa(from.sin_addr)) + ":" + std::to_string(ntohs(from.sin_port));
+            init.sa = from;
+            init.last_seq = hdr.seq - 1;
+            init.offset = hdr.t_send - now;   // guess until first pong
+            peers[hdr.node] = init;
+            st = &peers[hdr.node];
+            ping(st, now);
+        }
+        else
+            st = &it->second;
+
+        if (hdr.type == PEER_TYPE_PONG)
+        {
+            pong(st, buf, r, &hdr, rx);
+            continue;
+        }
+
+        /* loss by sequence gaps, late packets are dropped */
+        if ((int32_t)(hdr.seq - st->last_seq) <= 0)
+            continue;
+        st->lost += hdr.seq - st->last_seq - 1;
+        st->last_seq = hdr.seq;
+        st->packets++;
+        st->last_rx = now;
+
+        /* one way latency in local clock */
+        double latency = (double)(rx - (hdr.t_send - st->offset));
+        st->latency = st->packets > 1 ? 0.95 * st->latency + 0.05 * latency : latency;
+        if (latency > st->latency_max)
+            st->latency_max = latency;
+
+        for (i = 0; i < hdr.count; i++)
+        {
+            peer_pose_t pose;
+
+            peer_pose_unpack(buf + PEER_HEADER_SIZE + i * PEER_POSE_SIZE, PEER_POSE_SIZE, &pose);
+
+            pose.node = hdr.node;
+            pose.timestamp -= st->offset;
+            st->age = 0.95 * st->age + 0.05 * (double)(now - pose.timestamp);
+            st->poses++;
+
+            poses.push_back(pose);
+            cnt++;
+        }
+    }
+
+    /* periodic clock pings */
+    for (auto& it : peers)
+        if (now - it.second.last_ping >= PEER_PING_INTERVAL)
+            ping(&it.second, now);
+
+    return cnt;
+}
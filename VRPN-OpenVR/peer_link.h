@@ -0,0 +1,82 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "peer.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#endif
+
+#define PEER_PING_INTERVAL  250000      // microseconds
+#define PEER_PING_WINDOW    8           // clock samples kept, lowest round trip wins
+#define PEER_TIMEOUT        100000      // microseconds without poses before peer devices are lost
+
+/*
+    Sending side of peer mode: forwards device poses to aggregator and
+    answers its clock pings.
+*/
+class peer_sender
+{
+public:
+    peer_sender(uint32_t node, const char* target);
+    ~peer_sender();
+    bool isOpen();
+    const std::string& getTarget();
+    uint32_t getNode();
+    void send(const peer_pose_t* poses, int count, int64_t now);
+    void poll();
+    void setClockOffset(int64_t us);
+
+private:
+    int sock;
+    uint32_t node, seq_poses, seq_pong;
+    int64_t clock_offset;
+    std::string target;
+    struct sockaddr_in addr;
+};
+
+typedef struct
+{
+    uint32_t node;
+    std::string addr;
+    long packets, lost, poses;
+    uint32_t last_seq;
+    int64_t last_rx;
+    int64_t offset;             // peer clock - local clock, microseconds
+    int64_t rtt;                // round trip of sample used for offset
+    bool synced;                // offset is from ping, not first packet guess
+    double latency, latency_max;    // packet send to receive, microseconds
+    double age;                 // pose sample to receive, microseconds
+    int64_t sample_offset[PEER_PING_WINDOW], sample_rtt[PEER_PING_WINDOW];
+    int samples;
+    int64_t last_ping;
+    struct sockaddr_in sa;
+} peer_stat_t;
+
+/*
+    Receiving side of peer mode: collects poses from peers, converts their
+    timestamps to local clock and keeps per-peer latency statistics.
+*/
+class peer_aggregator
+{
+public:
+    peer_aggregator(int port);
+    ~peer_aggregator();
+    bool isOpen();
+    int getPort();
+    int poll(int64_t now, std::vector<peer_pose_t>& poses);
+    const std::map<uint32_t, peer_stat_t>& getPeers();
+
+private:
+    void ping(peer_stat_t* st, int64_t now);
+    void pong(peer_stat_t* st, unsigned char* buf, int len, peer_header_t* hdr, int64_t rx);
+
+    int sock, port;
+    uint32_t seq_ping;
+    std::map<uint32_t, peer_stat_t> peers;
+};
@@ -0,0 +1,277 @@
+#include "realtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+static void report_line(std::string& report, const char* format, ...)
+{
+    char line[256];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    report += line;
+    report += "\n";
+}
+
+/* touch stack pages tracking thread may use, so first deep call does not fault */
+#if defined(_MSC_VER)
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+static void prefault_stack()
+{
+    volatile unsigned char stack[REALTIME_STACK_PREFAULT];
+    size_t i;
+
+    for (i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+/* touch heap and give it back to allocator, which keeps it when trimming is off */
+static void prefault_heap()
+{
+    unsigned char* heap = (unsigned char*)malloc(REALTIME_HEAP_PREFAULT);
+    size_t i;
+
+    if (!heap)
+        return;
+    for (i = 0; i < REALTIME_HEAP_PREFAULT; i += 4096)
+        heap[i] = 0;
+    free(heap);
+}
+
+#if defined(_WIN32)
+
+static int apply_lock(std::string& report)
+{
+    if (!SetProcessWorkingSetSize(GetCurrentProcess(), REALTIME_WORKING_SET, 2 * REALTIME_WORKING_SET))
+    {
+        report_line(report, "memory: FAILED to set minimum working set %d MB (error %lu)", REALTIME_WORKING_SET >> 20, GetLastError());
+        return 1;
+    }
+
+    prefault_stack();
+    prefault_heap();
+    report_line(report, "memory: minimum working set %d MB, stack %d KB and heap %d MB prefaulted",
+        REALTIME_WORKING_SET >> 20, REALTIME_STACK_PREFAULT >> 10, REALTIME_HEAP_PREFAULT >> 20);
+    return 0;
+}
+
+static int apply_priority(int priority, std::string& report)
+{
+    if (!SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS))
+    {
+        report_line(report, "priority: FAILED to set high priority class (error %lu)", GetLastError());
+        return 1;
+    }
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+    {
+        report_line(report, "priority: FAILED to set time critical thread priority (error %lu)", GetLastError());
+        return 1;
+    }
+
+    report_line(report, "priority: high priority class, time critical thread");
+    return 0;
+}
+
+static int apply_cpu(int cpu, std::string& report)
+{
+    SYSTEM_INFO si;
+
+    GetSystemInfo(&si);
+    if (cpu >= (int)si.dwNumberOfProcessors || cpu >= (int)(8 * sizeof(DWORD_PTR)))
+    {
+        report_line(report, "cpu: FAILED, core %d does not exist (%lu cores)", cpu, si.dwNumberOfProcessors);
+        return 1;
+    }
+    if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu))
+    {
+        report_line(report, "cpu: FAILED to pin to core %d (error %lu)", cpu, GetLastError());
+        return 1;
+    }
+
+    report_line(report, "cpu: pinned to core %d", cpu);
+    return 0;
+}
+
+uint64_t realtime_page_faults()
+{
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return 0;
+
+    return pmc.PageFaultCount;
+}
+
+#elif defined(__linux__)
+
+static int apply_lock(std::string& report)
+{
+    struct rlimit rl;
+
+    /* freed memory stays in process, large blocks come from heap, not fresh mappings */
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE))
+    {
+        int err = errno;
+
+        getrlimit(RLIMIT_MEMLOCK, &rl);
+        report_line(report, "memory: FAILED to lock (%s), RLIMIT_MEMLOCK is %s%lu KB, needs CAP_IPC_LOCK or 'ulimit -l unlimited'",
+            strerror(err), rl.rlim_cur == RLIM_INFINITY ? "unlimited " : "",
+            rl.rlim_cur == RLIM_INFINITY ? 0UL : (unsigned long)(rl.rlim_cur >> 10));
+        prefault_stack();
+        prefault_heap();
+        return 1;
+    }
+
+    prefault_stack();
+    prefault_heap();
+    report_line(report, "memory: locked, stack %d KB and heap %d MB prefaulted",
+        REALTIME_STACK_PREFAULT >> 10, REALTIME_HEAP_PREFAULT >> 20);
+    return 0;
+}
+
+static int apply_priority(int priority, std::string& report)
+{
+    struct sched_param sp;
+    int r, policy = -1;
+
+    if (priority < sched_get_priority_min(SCHED_FIFO) || priority > sched_get_priority_max(SCHED_FIFO))
+    {
+        report_line(report, "priority: FAILED, SCHED_FIFO priority %d is out of range %d..%d", priority,
+            sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+        return 1;
+    }
+
+    memset(&sp, 0, sizeof(sp));
+    sp.sched_priority = priority;
+    r = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (r)
+    {
+        report_line(report, "priority: FAILED to set SCHED_FIFO %d (%s), needs CAP_SYS_NICE or rtprio limit", priority, strerror(r));
+        return 1;
+    }
+
+    /* check what scheduler actually has */
+    if (pthread_getschedparam(pthread_self(), &policy, &sp) || policy != SCHED_FIFO || sp.sched_priority != priority)
+    {
+        report_line(report, "priority: FAILED, scheduler reports policy %d priority %d", policy, sp.sched_priority);
+        return 1;
+    }
+
+    report_line(report, "priority: SCHED_FIFO %d", priority);
+    return 0;
+}
+
+static int apply_cpu(int cpu, std::string& report)
+{
+    cpu_set_t set;
+    int r;
+
+    if (cpu >= CPU_SETSIZE || cpu >= sysconf(_SC_NPROCESSORS_CONF))
+    {
+        report_line(report, "cpu: FAILED, core %d does not exist (%ld cores)", cpu, sysconf(_SC_NPROCESSORS_CONF));
+        return 1;
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (r)
+    {
+        report_line(report, "cpu: FAILED to pin to core %d (%s)", cpu, strerror(r));
+        return 1;
+    }
+
+    /* migration happens on next schedule */
+    sched_yield();
+    if (sched_getcpu() != cpu)
+    {
+        report_line(report, "cpu: FAILED, pinned to core %d but running on %d", cpu, sched_getcpu());
+        return 1;
+    }
+
+    report_line(report, "cpu: pinned to core %d", cpu);
+    return 0;
+}
+
+uint64_t realtime_page_faults()
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_THREAD, &ru))
+        return 0;
+
+    return (uint64_t)ru.ru_minflt + ru.ru_majflt;
+}
+
+#else
+
+/* other platforms: mallopt, SCHED_FIFO, thread affinity and per thread page faults are Linux only */
+
+static int apply_lock(std::string& report)
+{
+    prefault_stack();
+    prefault_heap();
+    report_line(report, "memory: FAILED to lock, not supported on this platform, stack %d KB and heap %d MB prefaulted",
+        REALTIME_STACK_PREFAULT >> 10, REALTIME_HEAP_PREFAULT >> 20);
+    return 1;
+}
+
+static int apply_priority(int priority, std::string& report)
+{
+    report_line(report, "priority: FAILED to set %d, not supported on this platform", priority);
+    return 1;
+}
+
+static int apply_cpu(int cpu, std::string& report)
+{
+    report_line(report, "cpu: FAILED to pin to core %d, not supported on this platform", cpu);
+    return 1;
+}
+
+uint64_t realtime_page_faults()
+{
+    return 0;
+}
+
+#endif
+
+int realtime_apply(const realtime_config_t* cfg, std::string& report)
+{
+    int failed = 0;
+
+    report.clear();
+
+    /* lock first, so pages touched by following steps stay resident */
+    if (cfg->lock)
+        failed += apply_lock(report);
+    if (cfg->priority > 0)
+        failed += apply_priority(cfg->priority, report);
+    if (cfg->cpu >= 0)
+        failed += apply_cpu(cfg->cpu, report);
+
+    return failed;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+#define REALTIME_STACK_PREFAULT     (512 * 1024)            // bytes of tracking thread stack touched in advance
+#define REALTIME_HEAP_PREFAULT      (32 * 1024 * 1024)      // bytes of heap touched and kept by allocator
+#define REALTIME_WORKING_SET        (256 * 1024 * 1024)     // Windows minimum working set, bytes
+
+typedef struct
+{
+    int priority;       // SCHED_FIFO priority 1..99 (Windows: any value - time critical thread of high priority process), 0 - keep
+    int cpu;            // core tracking thread is pinned to, -1 - any
+    int lock;           // lock memory, prefault stack and heap
+} realtime_config_t;
+
+/*
+    Real-time execution of tracking thread: applied to calling thread after
+    all helper threads (pacer, recorder, OpenVR attach) are started, so they
+    keep normal priority and affinity. Every step is checked, report gets
+    one line per step with what could not be applied and why. Returns
+    number of failed steps.
+*/
+int realtime_apply(const realtime_config_t* cfg, std::string& report);
+
+/* page faults of calling thread (Windows: of process, 0 on platforms other than Windows and Linux) since start */
+uint64_t realtime_page_faults();
@@ -0,0 +1,312 @@
+#include "recorder.h"
+#include <openvr.h>
+#include <iostream>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* ring is sized for ticks at 1000 Hz with up to 23 devices and cameras */
+#define FR_RECORDS_PER_SECOND   24000
+
+static double steady_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+flight_recorder::flight_recorder(const std::string& _prefix, double _seconds, double _jump, double _overrun) :
+    prefix(_prefix), seconds(_seconds), jump(_jump), overrun(_overrun), head(0),
+    tick(0), tick_triggers(0), tick_time(0), tick_start(0.0), tick_prev(0.0), tick_slack(0.0), batch_errors(0),
+    pending(0), pending_time(0.0), holdoff(0.0), running(true), dumps(0)
+{
+    uint64_t size = 1024;
+
+    while (size < seconds * FR_RECORDS_PER_SECOND)
+        size <<= 1;
+    ring.resize(size);
+    snapshot.resize(size);
+    mask = size - 1;
+
+    memset(cam_pos, 0, sizeof(cam_pos));
+    memset(cam_state, 0, sizeof(cam_state));
+    memset(cam_valid, 0, sizeof(cam_valid));
+    memset(cam_errors, 0, sizeof(cam_errors));
+    memset(dev_tracking, 0, sizeof(dev_tracking));
+
+    thread = std::thread(&flight_recorder::worker, this);
+}
+
+flight_recorder::~flight_recorder()
+{
+    running = false;
+    thread.join();
+}
+
+void flight_recorder::setSource(int kind, int idx, const std::string& name)
+{
+    std::lock_guard<std::mutex> guard(names_lock);
+
+    if (kind == FR_KIND_DEVICE || kind == FR_KIND_CAMERA)
+        if (idx >= 0 && idx < SHMEM_MAX_DEVICES)
+            names[kind - 1][idx] = name;
+}
+
+const std::string& flight_recorder::getPrefix()
+{
+    return prefix;
+}
+
+double flight_recorder::getSeconds()
+{
+    return seconds;
+}
+
+long flight_recorder::getDumps()
+{
+    return dumps;
+}
+
+void flight_recorder::getLastDump(char* buf, int len)
+{
+    std::lock_guard<std::mutex> guard(names_lock);
+
+    snprintf(buf, len, "%s", last_dump.c_str());
+}
+
+void flight_recorder::trigger(uint32_t reason)
+{
+    tick_triggers |= reason;
+
+    if (tick_start < holdoff.load(std::memory_order_relaxed))
+        return;
+
+    if (!pending.load(std::memory_order_relaxed))
+        pending_time.store(tick_start, std::memory_order_relaxed);
+    pending.fetch_or(reason, std::memory_order_release);
+}
+
+fr_record_t* flight_recorder::append(int kind, int idx)
+{
+    fr_record_t* r = &ring[head.load(std::memory_order_relaxed) & mask];
+
+    r->tick = tick;
+    r->kind = kind;
+    r->source = idx;
+
+    return r;
+}
+
+void flight_recorder::tickSlack(double seconds)
+{
+    tick_slack = seconds;
+}
+
+void flight_recorder::tickBegin(struct timeval *tv)
+{
+    tick_prev = tick_start;
+    tick_start = steady_now();
+    tick_time = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    tick_triggers = 0;
+
+    if (tick && overrun > 0.0 && tick_start - tick_prev > overrun + tick_slack)
+        trigger(FR_TRIGGER_OVERRUN);
+}
+
+void flight_recorder::device(int idx, q_vec_type pos, q_type quat, int tracking, int valid)
+{
+    if (idx < 0 || idx >= SHMEM_MAX_DEVICES)
+        return;
+
+    fr_record_t* r = append(FR_KIND_DEVICE, idx);
+    memcpy(r->pose.pos, pos, sizeof(r->pose.pos));
+    memcpy(r->pose.quat, quat, sizeof(r->pose.quat));
+    r->pose.timestamp = tick_time;
+    r->pose.tracking = tracking;
+    r->pose.valid = valid;
+    r->pose.state = 0;
+    r->sent = r->errors = 0;
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    if (dev_tracking[idx] == vr::TrackingResult_Running_OK && tracking != vr::TrackingResult_Running_OK)
+        trigger(FR_TRIGGER_STATE);
+    dev_tracking[idx] = tracking;
+}
+
+void flight_recorder::camera(int idx, q_vec_type pos, q_type quat, int state, long sent, long errors)
+{
+    if (idx < 0 || idx >= SHMEM_MAX_CAMERAS)
+        return;
+
+    fr_record_t* r = append(FR_KIND_CAMERA, idx);
+    memcpy(r->pose.pos, pos, sizeof(r->pose.pos));
+    memcpy(r->pose.quat, quat, sizeof(r->pose.quat));
+    r->pose.timestamp = tick_time;
+    r->pose.tracking = 0;
+    r->pose.valid = 1;
+    r->pose.state = state;
+    r->sent = (int32_t)sent;
+    r->errors = (int32_t)errors;
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    if (cam_valid[idx])
+    {
+        if (jump > 0.0 && q_vec_distance(pos, cam_pos[idx]) > jump)
+            trigger(FR_TRIGGER_JUMP);
+        if (state != cam_state[idx])
+            trigger(FR_TRIGGER_STATE);
+        if (errors > cam_errors[idx])
+            trigger(FR_TRIGGER_SEND);
+    }
+    q_vec_copy(cam_pos[idx], pos);
+    cam_state[idx] = state;
+    cam_errors[idx] = errors;
+    cam_valid[idx] = 1;
+}
+
+void flight_recorder::tickEnd(long sent, long errors)
+{
+    if (errors > batch_errors)
+        trigger(FR_TRIGGER_SEND);
+    batch_errors = errors;
+
+    fr_record_t* r = append(FR_KIND_TICK, 0);
+    r->timing.timestamp = tick_time;
+    r->timing.interval = tick ? tick_start - tick_prev : 0.0;
+    r->timing.duration = steady_now() - tick_start;
+    r->timing.triggers = tick_triggers;
+    r->sent = (int32_t)sent;
+    r->errors = (int32_t)errors;
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+    tick++;
+}
+
+void flight_recorder::worker()
+{
+    while (running)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        if (!pending.load(std::memory_order_acquire))
+            continue;
+
+        /* let ring capture what happened after trigger */
+        if (steady_now() < pending_time.load(std::memory_order_relaxed) + FR_POST_TIME)
+            continue;
+
+        uint32_t reasons = pending.exchange(0);
+        holdoff = steady_now() + seconds;
+        dump(reasons);
+    }
+}
+
+static void name_sanitize(char* name)
+{
+    for (; *name; name++)
+        if (!((*name >= '0' && *name <= '9') || (*name >= 'a' && *name <= 'z') || (*name >= 'A' && *name <= 'Z') || *name == '-'))
+            *name = '_';
+}
+
+void flight_recorder::dump(uint32_t reasons)
+{
+    uint64_t i, h, first, from, valid_from, cap = ring.size();
+    FILE *ticks, *sends, *files[2][SHMEM_MAX_DEVICES];
+    char base[512], path[1024], stamp[32];
+    time_t now = time(NULL);
+    struct tm tm;
+
+    /*
+        Copy ring without stopping writer, so copy may contain torn records.
+        Writer that published head H is filling slot of record H - cap,
+        only records from H - cap + 1 on are intact, older ones are dropped.
+    */
+    h = head.load(std::memory_order_acquire);
+    first = from = h > cap ? h - cap : 0;
+    for (i = from; i < h; i++)
+        snapshot[i - first] = ring[i & mask];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid_from = head.load(std::memory_order_relaxed);
+    valid_from = valid_from + 1 > cap ? valid_from + 1 - cap : 0;
+    if (valid_from > from)
+        from = valid_from;
+    if (from >= h)
+        return;
+
+#if defined(_WIN32)
+    localtime_s(&tm, &now);
+#else
+    localtime_r(&now, &tm);
+#endif
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    snprintf(base, sizeof(base), "%s-%s", prefix.c_str(), stamp);
+
+    snprintf(path, sizeof(path), "%s-ticks.csv", base);
+    ticks = fopen(path, "wt");
+    snprintf(path, sizeof(path), "%s-sends.csv", base);
+    sends = fopen(path, "wt");
+    if (!ticks || !sends)
+    {
+        std::cerr << "Failed to write flight recorder dump [" << base << "]" << std::endl;
+        if (ticks)
+            fclose(ticks);
+        if (sends)
+            fclose(sends);
+        return;
+    }
+
+    fprintf(ticks, "# triggers: 0x%02X (1 - overrun, 2 - jump, 4 - state, 8 - send, 16 - key)\n", reasons);
+    fprintf(ticks, "tick,time,interval_ms,duration_ms,triggers,batch_sent,batch_errors\n");
+    fprintf(sends, "tick,camera,sent,errors\n");
+    memset(files, 0, sizeof(files));
+
+    for (i = from; i < h; i++)
+    {
+        fr_record_t* r = &snapshot[i - first];
+
+        if (r->kind == FR_KIND_TICK)
+        {
+            fprintf(ticks, "%u,%.6f,%.3f,%.3f,%u,%d,%d\n", r->tick, r->timing.timestamp / 1000000.0,
+                r->timing.interval * 1000.0, r->timing.duration * 1000.0, r->timing.triggers, r->sent, r->errors);
+            continue;
+        }
+
+        if ((r->kind != FR_KIND_DEVICE && r->kind != FR_KIND_CAMERA) || r->source >= SHMEM_MAX_DEVICES)
+            continue;
+
+        FILE** f = &files[r->kind - 1][r->source];
+        if (!*f)
+        {
+            char name[256];
+            {
+                std::lock_guard<std::mutex> guard(names_lock);
+                snprintf(name, sizeof(name), "%s", names[r->kind - 1][r->source].empty() ?
+                    std::to_string(r->source).c_str() : names[r->kind - 1][r->source].c_str());
+            }
+            name_sanitize(name);
+            snprintf(path, sizeof(path), "%s-%s-%s.bin", base, r->kind == FR_KIND_DEVICE ? "device" : "camera", name);
+            *f = fopen(path, "wb");
+            if (!*f)
+                continue;
+        }
+        fwrite(&r->pose, sizeof(r->pose), 1, *f);
+
+        if (r->kind == FR_KIND_CAMERA)
+            fprintf(sends, "%u,%u,%d,%d\n", r->tick, r->source, r->sent, r->errors);
+    }
+
+    for (i = 0; i < SHMEM_MAX_DEVICES; i++)
+    {
+        if (files[0][i])
+            fclose(files[0][i]);
+        if (files[1][i])
+            fclose(files[1][i]);
+    }
+    fclose(ticks);
+    fclose(sends);
+
+    {
+        std::lock_guard<std::mutex> guard(names_lock);
+        last_dump = base;
+    }
+    dumps++;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <quat.h>
+#include "shmem.h"
+
+/* record kinds */
+#define FR_KIND_TICK            0
+#define FR_KIND_DEVICE          1
+#define FR_KIND_CAMERA          2
+
+/* dump triggers, bit mask */
+#define FR_TRIGGER_OVERRUN      0x01    // tick started later than overrun threshold after previous one
+#define FR_TRIGGER_JUMP         0x02    // camera output moved more than jump threshold in one tick
+#define FR_TRIGGER_STATE        0x04    // camera tracking state changed or device lost tracking
+#define FR_TRIGGER_SEND         0x08    // FreeD or batch send failed
+#define FR_TRIGGER_KEY          0x10    // operator pressed key
+
+#define FR_POST_TIME            0.5     // seconds recorded after trigger before dump
+
+typedef struct
+{
+    uint32_t tick;
+    uint16_t kind;              // FR_KIND_*
+    uint16_t source;            // device or camera index
+    int32_t sent, errors;       // packets sent and send errors, cumulative: FreeD of camera, batch of tick
+    union
+    {
+        shmem_pose_t pose;      // FR_KIND_DEVICE: OpenVR space, FR_KIND_CAMERA: UE4 space
+        struct
+        {
+            int64_t timestamp;  // tick time, microseconds since epoch
+            double interval;    // since previous tick start, seconds
+            double duration;    // processing time of tick, seconds
+            uint32_t triggers;  // FR_TRIGGER_* raised during tick
+        } timing;
+    };
+} fr_record_t;
+
+/*
+    Flight recorder: every tick main loop appends raw device poses, camera
+    outputs, send counters and tick timing to a fixed-size ring. Ring has
+    single writer and is lock-free: writer publishes head index after
+    record is written, dump thread copies ring and drops every record that
+    writer could have touched while copying, including the slot being
+    written, so torn records never reach dump files.
+
+    When trigger fires, background thread waits FR_POST_TIME and dumps ring
+    into files starting with <prefix>-<date>-<time>:
+
+        -ticks.csv              tick timing, triggers and batch send counters
+        -sends.csv              FreeD send counters of cameras
+        -device-<serial>.bin    shmem_pose_t records, readable by filter_sweep
+        -camera-<name>.bin      shmem_pose_t records, state field is camera tracking state
+
+    Triggers are ignored for ring length after dump, so persistent anomaly
+    does not flood disk.
+*/
+class flight_recorder
+{
+public:
+    flight_recorder(const std::string& prefix, double seconds, double jump, double overrun);
+    ~flight_recorder();
+    void setSource(int kind, int idx, const std::string& name);
+    void tickSlack(double seconds);
+    void tickBegin(struct timeval *tv);
+    void device(int idx, q_vec_type pos, q_type quat, int tracking, int valid);
+    void camera(int idx, q_vec_type pos, q_type quat, int state, long sent, long errors);
+    void tickEnd(long sent, long errors);
+    void trigger(uint32_t reason);
+    const std::string& getPrefix();
+    double getSeconds();
+    long getDumps();
+    void getLastDump(char* buf, int len);
+
+private:
+    fr_record_t* append(int kind, int idx);
+    void worker();
+    void dump(uint32_t reasons);
+
+    std::string prefix;
+    double seconds, jump, overrun;
+
+    /* ring, written by main loop only */
+    std::vector<fr_record_t> ring;
+    uint64_t mask;
+    std::atomic<uint64_t> head;
+
+    /* main loop state */
+    uint32_t tick;
+    uint32_t tick_triggers;
+    int64_t tick_time;
+    double tick_start, tick_prev;
+    double tick_slack;      // added to overrun threshold of next tick, it was scheduled later on purpose
+    q_vec_type cam_pos[SHMEM_MAX_CAMERAS];
+    int cam_state[SHMEM_MAX_CAMERAS], cam_valid[SHMEM_MAX_CAMERAS];
+    long cam_errors[SHMEM_MAX_CAMERAS];
+    int dev_tracking[SHMEM_MAX_DEVICES];
+    long batch_errors;
+
+    /* trigger handoff to dump thread */
+    std::atomic<uint32_t> pending;
+    std::atomic<double> pending_time, holdoff;
+    std::atomic<bool> running;
+    std::atomic<long> dumps;
+
+    /* dump thread */
+    std::thread thread;
+    std::vector<fr_record_t> snapshot;
+    std::mutex names_lock;
+    std::string names[2][SHMEM_MAX_DEVICES];   // by kind - 1, device or camera index
+    std::string last_dump;
+};
@@ -0,0 +1,235 @@
+#ifndef shmem_h
+#define shmem_h
+
+/*
+    Shared memory output segment layout and header-only reader.
+
+    Server publishes latest pose of every tracked device and every virtual
+    camera into a named shared memory segment. Each slot is protected by a
+    seqlock: writer makes sequence odd, updates data, makes it even again.
+    Reader copies slot and retries if sequence changed or was odd.
+
+    Device slots are indexed by OpenVR tracked device index, poses are in
+    OpenVR space. After OpenVR runtime restart device may come back under
+    another index: its old slot loses name and serial, so look devices up
+    by name or serial again when their slot stays invalid. Camera slots are indexed by camera index (FreeD ID - 1),
+    poses are in UE4 space (same values as sent over VRPN with
+    default "coord ue4").
+
+    Usage:
+
+        shmem_reader rd;
+        if (!rd.open("VRPN-FreeD-OpenVR"))
+            return;
+        int cam = rd.findCamera("virtual/CAMERA-78");
+        shmem_pose_t pose;
+        if (cam >= 0 && rd.readCamera(cam, &pose))
+            use(pose.pos, pose.quat);
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define SHMEM_MAGIC             0x44657246  /* "FreD" */
+#define SHMEM_VERSION           2
+#define SHMEM_MAX_DEVICES       64          /* vr::k_unMaxTrackedDeviceCount */
+#define SHMEM_MAX_CAMERAS       32
+#define SHMEM_NAME_LEN          64
+#define SHMEM_SERIAL_LEN        32
+#define SHMEM_READ_RETRIES      64
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory seqlock requires lock-free 32-bit atomics");
+
+typedef struct
+{
+    double pos[3];                  // position, meters
+    double quat[4];                 // rotation, q_type order: x, y, z, w
+    int64_t timestamp;              // sample time, microseconds since epoch
+    int32_t tracking;               // vr::ETrackingResult of source device
+    int32_t valid;                  // pose is valid
+    int32_t state;                  // cameras only: cam_tracking_state, 0 - tracking OK
+    int32_t reserved;
+} shmem_pose_t;
+
+typedef struct
+{
+    std::atomic<uint32_t> seq;      // odd while writer updates pose
+    uint32_t reserved;
+    char name[SHMEM_NAME_LEN];      // VRPN sender name, set on device discovery, empty if device moved to another slot
+    char serial[SHMEM_SERIAL_LEN];  // tracker serial
+    shmem_pose_t pose;
+} shmem_slot_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                  // sizeof(shmem_layout_t)
+    uint32_t reserved;
+    std::atomic<uint32_t> devices_cnt;  // highest used device slot + 1
+    std::atomic<uint32_t> cameras_cnt;  // highest used camera slot + 1
+    std::atomic<uint32_t> ticks;        // incremented by server every mainloop
+    uint32_t reserved2;
+    shmem_slot_t devices[SHMEM_MAX_DEVICES];
+    shmem_slot_t cameras[SHMEM_MAX_CAMERAS];
+} shmem_layout_t;
+
+static inline void shmem_slot_write(shmem_slot_t* slot, const shmem_pose_t* pose)
+{
+    uint32_t s = slot->seq.load(std::memory_order_relaxed);
+
+    slot->seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot->pose, pose, sizeof(shmem_pose_t));
+    slot->seq.store(s + 2, std::memory_order_release);
+}
+
+static inline int shmem_slot_read(const shmem_slot_t* slot, shmem_pose_t* pose)
+{
+    int r;
+
+    for (r = 0; r < SHMEM_READ_RETRIES; r++)
+    {
+        uint32_t s1, s2;
+
+        s1 = slot->seq.load(std::memory_order_acquire);
+        if (s1 & 1)
+            continue;
+
+        memcpy(pose, &slot->pose, sizeof(shmem_pose_t));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        s2 = slot->seq.load(std::memory_order_relaxed);
+        if (s1 == s2)
+            return s1 != 0; // never written slot is not a pose
+    }
+
+    return 0;
+}
+
+class shmem_reader
+{
+public:
+    shmem_reader() : layout(nullptr)
+#if defined(_WIN32)
+        , mapping(NULL)
+#endif
+    {};
+
+    ~shmem_reader() { close(); };
+
+    bool open(const char* name)
+    {
+        void* p = nullptr;
+
+        close();
+
+#if defined(_WIN32)
+        mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+        if (!mapping)
+            return false;
+        p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(shmem_layout_t));
+        if (!p)
+        {
+            CloseHandle(mapping);
+            mapping = NULL;
+            return false;
+        }
+#else
+        char path[SHMEM_NAME_LEN + 2];
+        int fd;
+
+        snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+        fd = shm_open(path, O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+        p = mmap(NULL, sizeof(shmem_layout_t), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            return false;
+#endif
+        layout = (const shmem_layout_t*)p;
+
+        if (layout->magic != SHMEM_MAGIC || layout->version != SHMEM_VERSION || layout->size != sizeof(shmem_layout_t))
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    };
+
+    void close()
+    {
+        if (!layout)
+            return;
+#if defined(_WIN32)
+        UnmapViewOfFile((LPCVOID)layout);
+        CloseHandle(mapping);
+        mapping = NULL;
+#else
+        munmap((void*)layout, sizeof(shmem_layout_t));
+#endif
+        layout = nullptr;
+    };
+
+    bool isOpen() { return layout != nullptr; };
+
+    uint32_t ticks() { return layout->ticks.load(std::memory_order_acquire); };
+    int devicesCount() { return layout->devices_cnt.load(std::memory_order_acquire); };
+    int camerasCount() { return layout->cameras_cnt.load(std::memory_order_acquire); };
+
+    const char* deviceName(int idx) { return layout->devices[idx].name; };
+    const char* cameraName(int idx) { return layout->cameras[idx].name; };
+
+    bool readDevice(int idx, shmem_pose_t* pose)
+    {
+        if (idx < 0 || idx >= SHMEM_MAX_DEVICES)
+            return false;
+        return shmem_slot_read(&layout->devices[idx], pose) != 0;
+    };
+
+    bool readCamera(int idx, shmem_pose_t* pose)
+    {
+        if (idx < 0 || idx >= SHMEM_MAX_CAMERAS)
+            return false;
+        return shmem_slot_read(&layout->cameras[idx], pose) != 0;
+    };
+
+    int findDevice(const char* name_or_serial)
+    {
+        int i, c = devicesCount();
+        for (i = 0; i < c; i++)
+            if (!strcmp(layout->devices[i].name, name_or_serial) || !strcmp(layout->devices[i].serial, name_or_serial))
+                return i;
+        return -1;
+    };
+
+    int findCamera(const char* name)
+    {
+        int i, c = camerasCount();
+        for (i = 0; i < c; i++)
+            if (!strcmp(layout->cameras[i].name, name))
+                return i;
+        return -1;
+    };
+
+private:
+    const shmem_layout_t* layout;
+#if defined(_WIN32)
+    HANDLE mapping;
+#endif
+};
+
+#endif /* shmem_h */
@@ -0,0 +1,168 @@
+#include "shmem_server.h"
+#include <iostream>
+#include <new>
+
+shmem_server::shmem_server(const std::string& _name) : name(_name), layout(nullptr)
+{
+    void* p = nullptr;
+
+#if defined(_WIN32)
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(shmem_layout_t), name.c_str());
+    if (!mapping)
+    {
+        std::cerr << "Failed to create shared memory [" << name << "], error " << GetLastError() << std::endl;
+        return;
+    }
+    p = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(shmem_layout_t));
+    if (!p)
+    {
+        std::cerr << "Failed to map shared memory [" << name << "], error " << GetLastError() << std::endl;
+        CloseHandle(mapping);
+        mapping = NULL;
+        return;
+    }
+#else
+    int fd;
+
+    if (name[0] != '/')
+        name = "/" + name;
+
+    fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to create shared memory [" << name << "]" << std::endl;
+        return;
+    }
+    if (ftruncate(fd, sizeof(shmem_layout_t)))
+    {
+        std::cerr << "Failed to resize shared memory [" << name << "]" << std::endl;
+        ::close(fd);
+        return;
+    }
+    p = mmap(NULL, sizeof(shmem_layout_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        std::cerr << "Failed to map shared memory [" << name << "]" << std::endl;
+        return;
+    }
+#endif
+
+    // reset previous content, readers validate magic before using it
+    memset(p, 0, sizeof(shmem_layout_t));
+    layout = new (p) shmem_layout_t;
+    layout->size = sizeof(shmem_layout_t);
+    layout->version = SHMEM_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    layout->magic = SHMEM_MAGIC;
+}
+
+shmem_server::~shmem_server()
+{
+    if (!layout)
+        return;
+
+    layout->magic = 0;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(layout);
+    CloseHandle(mapping);
+#else
+    munmap(layout, sizeof(shmem_layout_t));
+    shm_unlink(name.c_str());
+#endif
+    layout = nullptr;
+}
+
+bool shmem_server::isOpen()
+{
+    return layout != nullptr;
+}
+
+const std::string& shmem_server::getName()
+{
+    return name;
+}
+
+void shmem_server::setSlot(shmem_slot_t* slot, std::atomic<uint32_t>* cnt, int idx, const std::string& name, const std::string& serial)
+{
+    strncpy(slot->name, name.c_str(), SHMEM_NAME_LEN - 1);
+    strncpy(slot->serial, serial.c_str(), SHMEM_SERIAL_LEN - 1);
+
+    if (cnt->load(std::memory_order_relaxed) < (uint32_t)(idx + 1))
+        cnt->store(idx + 1, std::memory_order_release);
+}
+
+/*
+    Device reattached after runtime restart may get another OpenVR index,
+    its previous slot is unnamed then, so readers looking it up by name or
+    serial find the live slot, not the stale one.
+*/
+void shmem_server::setDevice(int idx, const std::string& name, const std::string& serial)
+{
+    int i, c;
+
+    if (!layout || idx < 0 || idx >= SHMEM_MAX_DEVICES)
+        return;
+
+    c = (int)layout->devices_cnt.load(std::memory_order_relaxed);
+    for (i = 0; i < c; i++)
+    {
+        shmem_slot_t* slot = &layout->devices[i];
+
+        if (i == idx || strncmp(slot->name, name.c_str(), SHMEM_NAME_LEN - 1))
+            continue;
+        memset(slot->name, 0, SHMEM_NAME_LEN);
+        memset(slot->serial, 0, SHMEM_SERIAL_LEN);
+    }
+
+    setSlot(&layout->devices[idx], &layout->devices_cnt, idx, name, serial);
+}
+
+void shmem_server::setCamera(int idx, const std::string& name, const std::string& serial)
+{
+    if (!layout || idx < 0 || idx >= SHMEM_MAX_CAMERAS)
+        return;
+    setSlot(&layout->cameras[idx], &layout->cameras_cnt, idx, name, serial);
+}
+
+void shmem_server::publish(shmem_slot_t* slot, q_vec_type pos, q_type quat, struct timeval *tv, int tracking, int valid, int state)
+{
+    shmem_pose_t pose;
+
+    pose.pos[0] = pos[0];
+    pose.pos[1] = pos[1];
+    pose.pos[2] = pos[2];
+    pose.quat[0] = quat[0];
+    pose.quat[1] = quat[1];
+    pose.quat[2] = quat[2];
+    pose.quat[3] = quat[3];
+    pose.timestamp = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    pose.tracking = tracking;
+    pose.valid = valid;
+    pose.state = state;
+    pose.reserved = 0;
+
+    shmem_slot_write(slot, &pose);
+}
+
+void shmem_server::publishDevice(int idx, q_vec_type pos, q_type quat, struct timeval *tv, int tracking, int valid)
+{
+    if (!layout || idx < 0 || idx >= SHMEM_MAX_DEVICES)
+        return;
+    publish(&layout->devices[idx], pos, quat, tv, tracking, valid, 0);
+}
+
+void shmem_server::publishCamera(int idx, q_vec_type pos, q_type quat, struct timeval *tv, int tracking, int valid, int state)
+{
+    if (!layout || idx < 0 || idx >= SHMEM_MAX_CAMERAS)
+        return;
+    publish(&layout->cameras[idx], pos, quat, tv, tracking, valid, state);
+}
+
+void shmem_server::tick()
+{
+    if (!layout)
+        return;
+    layout->ticks.fetch_add(1, std::memory_order_release);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <quat.h>
+#include "shmem.h"
+
+class shmem_server
+{
+public:
+    shmem_server(const std::string& name);
+    ~shmem_server();
+    bool isOpen();
+    const std::string& getName();
+    void setDevice(int idx, const std::string& name, const std::string& serial);
+    void setCamera(int idx, const std::string& name, const std::string& serial);
+    void publishDevice(int idx, q_vec_type pos, q_type quat, struct timeval *tv, int tracking, int valid);
+    void publishCamera(int idx, q_vec_type pos, q_type quat, struct timeval *tv, int tracking, int valid, int state);
+    void tick();
+
+private:
+    static void setSlot(shmem_slot_t* slot, std::atomic<uint32_t>* cnt, int idx, const std::string& name, const std::string& serial);
+    static void publish(shmem_slot_t* slot, q_vec_type pos, q_type quat, struct timeval *tv, int tracking, int valid, int state);
+
+    std::string name;
+    shmem_layout_t* layout;
+#if defined(_WIN32)
+    HANDLE mapping;
+#endif
+};
@@ -5,23 +5,50 @@
 #include "vrpn_Server_OpenVR.h"
 #include "console.h"
 
+/* whole string is a number, unlike atof() which takes garbage as zero */
+static int parse_number(const char* str, double* v)
+{
+    char* end;
+
+    *v = strtod(str, &end);
+
+    return end == str || *end ? -1 : 0;
+}
+
+/* whole string is an integer */
+static int parse_int(const char* str, long* v)
+{
+    char* end;
+
+    *v = strtol(str, &end, 10);
+
+    return end == str || *end ? -1 : 0;
+}
+
 vrpn_Server_OpenVR::vrpn_Server_OpenVR(int argc, char *argv[])
 {
     int cam_idx = 0;
     std::string connectionName = "";
     int listen_vrpn_port = vrpn_DEFAULT_LISTEN_PORT_NO;
+    int idle_interval = 0;
+    double idle_static = 0.0;
 
     sleep_interval = 1;
+    input_events = false;
+    derivatives = DERIV_NONE;
+    discovery = false;
+    alloc_tick = alloc_steady = 0;
+    alloc_steady_ticks = 0;
+    realtime = { 0, -1, 0 };
+    realtime_failed = 0;
+    fault_tick = fault_steady = 0;
+    reference_point[0] = reference_point[1] = reference_point[2] = 0.0;
+    reference_position[0] = reference_position[1] = reference_position[2] = 0.0;
+    reference_quat[0] = reference_quat[1] = reference_quat[2] = 0.0;
+    reference_quat[3] = 1.0;    // identity until calibration keypress
 
-    // Initialize OpenVR
-    vr::EVRInitError eError = vr::VRInitError_None;
-    vr = std::unique_ptr<vr::IVRSystem>(vr::VR_Init(&eError, vr::VRApplication_Utility/*VRApplication_Background*/)); /// https://github.com/ValveSoftware/openvr/wiki/API-Documentation
-    if (eError != vr::VRInitError_None)
-    {
-//        vr.reset(nullptr);
-        std::cerr << "Unable to init VR runtime: " << vr::VR_GetVRInitErrorAsEnglishDescription(eError) << std::endl;
-        exit(1);
-    };
+    // Initialize OpenVR in background, VRPN and FreeD are served without it
+    openvr = std::make_unique<openvr_link>(vr::VRApplication_Utility/*VRApplication_Background*/);
 
     // Process arguments
     if (argc > 1)
@@ -45,6 +72,123 @@ vrpn_Server_OpenVR::vrpn_Server_OpenVR(int argc, char *argv[])
                 reference_point[2] = atof(argv[p + 3]);
                 p += 4;
             }
+            else if (!strcmp(argv[p], "shmem") && (p + 1) <= argc)  // 1 argument: shmem <segment name>
+            {
+                shmem = std::make_unique<shmem_server>(argv[p + 1]);
+                p += 2;
+            }
+            else if (!strcmp(argv[p], "peer_send") && (p + 2) < argc)  // 2 arguments: peer_send <host:port> <node id>
+            {
+                peer_tx = std::make_unique<peer_sender>(atoi(argv[p + 2]), argv[p + 1]);
+                p += 3;
+            }
+            else if (!strcmp(argv[p], "batch") && (p + 1) < argc)  // 1 argument: batch <host:port>[,options]
+            {
+                batch_targets.push_back(std::make_unique<batch_sender>(argv[p + 1]));
+                p += 2;
+            }
+            else if (!strcmp(argv[p], "record") && (p + 4) < argc)  // 4 arguments: record <file prefix> <seconds> <jump mm> <overrun ms>
+            {
+                recorder = std::make_unique<flight_recorder>(argv[p + 1], atof(argv[p + 2]), atof(argv[p + 3]) / 1000.0, atof(argv[p + 4]) / 1000.0);
+                p += 5;
+            }
+            else if (!strcmp(argv[p], "idle") && (p + 2) < argc)  // 2 arguments: idle <poll interval ms> <static seconds>
+            {
+                idle_interval = atoi(argv[p + 1]);
+                idle_static = atof(argv[p + 2]);
+                if (idle_interval <= 0 || idle_interval > POLL_IDLE_MAX)
+                {
+                    std::cerr << "Failed to parse argument [" << argv[p] << "], idle poll interval should be 1.." << POLL_IDLE_MAX << " ms" << std::endl;
+                    exit(1);
+                }
+                p += 3;
+            }
+            else if (!strcmp(argv[p], "realtime") && (p + 3) < argc)  // 3 arguments: realtime <priority> <cpu> <lock memory>
+            {
+                realtime.priority = atoi(argv[p + 1]);
+                realtime.cpu = atoi(argv[p + 2]);
+                realtime.lock = atoi(argv[p + 3]);
+                p += 4;
+            }
+            else if (!strcmp(argv[p], "aggregate") && (p + 2) < argc)  // 2 arguments: aggregate <devices tracker name|-> <cameras tracker name|->
+            {
+                aggregate_devices_name = strcmp(argv[p + 1], "-") ? argv[p + 1] : "";
+                aggregate_cameras_name = strcmp(argv[p + 2], "-") ? argv[p + 2] : "";
+                p += 3;
+            }
+            else if (!strcmp(argv[p], "sensor") && (p + 2) < argc)  // 2 arguments: sensor <device serial|camera name> <aggregate sensor index>
+            {
+                long sensor;
+
+                if (parse_int(argv[p + 2], &sensor) || sensor < 0 || sensor > AGGREGATE_PIN_MAX)
+                {
+                    std::cerr << "Failed to parse argument [" << argv[p] << "], sensor index [" << argv[p + 2] << "] should be 0.." << AGGREGATE_PIN_MAX << std::endl;
+                    exit(1);
+                }
+                sensor_pins[argv[p + 1]] = (int)sensor;
+                p += 3;
+            }
+            else if (!strcmp(argv[p], "peer_listen") && (p + 1) < argc)  // 1 argument: peer_listen <udp port>
+            {
+                peer_rx = std::make_unique<peer_aggregator>(atoi(argv[p + 1]));
+                p += 2;
+            }
+            else if (!strcmp(argv[p], "input") && (p + 1) < argc)   // 1 argument: input poll|events
+            {
+                if (!strcmp(argv[p + 1], "events"))
+                    input_events = true;
+                else if (!strcmp(argv[p + 1], "poll"))
+                    input_events = false;
+                else
+                {
+                    std::cerr << "Failed to parse argument [" << argv[p] << "], unknown input mode [" << argv[p + 1] << "]" << std::endl;
+                    exit(1);
+                }
+                p += 2;
+            }
+            else if (!strcmp(argv[p], "derivatives") && (p + 1) < argc)   // 1 argument: derivatives none|velocity|acceleration
+            {
+                if (!strcmp(argv[p + 1], "none"))
+                    derivatives = DERIV_NONE;
+                else if (!strcmp(argv[p + 1], "velocity"))
+                    derivatives = DERIV_VELOCITY;
+                else if (!strcmp(argv[p + 1], "acceleration"))
+                    derivatives = DERIV_ACCELERATION;
+                else
+                {
+                    std::cerr << "Failed to parse argument [" << argv[p] << "], unknown derivatives [" << argv[p + 1] << "]" << std::endl;
+                    exit(1);
+                }
+                p += 2;
+            }
+            else if (!strcmp(argv[p], "report") && (p + 5) < argc)  // 5 arguments: report <CLASS|all> <deadband mm> <deadband deg> <keepalive hz> <max rate hz>
+            {
+                report_policy_t policy;
+                size_t c;
+                int found = 0;
+                static const vr::ETrackedDeviceClass classes[] = {
+                    vr::TrackedDeviceClass_HMD, vr::TrackedDeviceClass_Controller,
+                    vr::TrackedDeviceClass_GenericTracker, vr::TrackedDeviceClass_TrackingReference };
+
+                policy.deadband_pos = atof(argv[p + 2]) / 1000.0;
+                policy.deadband_rot = atof(argv[p + 3]) * 3.1415926 / 180.0;
+                policy.keepalive = atof(argv[p + 4]) > 0.0 ? 1.0 / atof(argv[p + 4]) : 0.0;
+                policy.min_interval = atof(argv[p + 5]) > 0.0 ? 1.0 / atof(argv[p + 5]) : 0.0;
+
+                for (c = 0; c < sizeof(classes) / sizeof(classes[0]); c++)
+                    if (!strcmp(argv[p + 1], "all") || getDeviceClassName(classes[c]) == argv[p + 1])
+                    {
+                        report_policies[classes[c]] = policy;
+                        found = 1;
+                    }
+
+                if (!found)
+                {
+                    std::cerr << "Failed to parse argument [" << argv[p] << "], unknown device class [" << argv[p + 1] << "]" << std::endl;
+                    exit(1);
+                }
+                p += 6;
+            }
             else if (!strcmp(argv[p], "cam") && (p + 5) <= argc)    // 5 argument: cam <NAME> <TRACKER SERIAL> <x> <y> <z>
             {
                 // Initialize VRPN Connection
@@ -74,40 +218,73 @@ vrpn_Server_OpenVR::vrpn_Server_OpenVR(int argc, char *argv[])
 
                 p += 6;
 
-                /* check if dst for free-d specified */
-                while (p < argc && !strcmp(argv[p], "filter"))
+                /* camera options: filters, FreeD targets and additional trackers */
+                while (p < argc)
                 {
-                    if (!strcmp(argv[p + 1], "kalman"))
+                    if (!strcmp(argv[p], "filter") && (p + 3) < argc)
                     {
-                        newCAM.get()->filterAdd(new filter_kalman(atof(argv[p + 2]), atof(argv[p + 3])));
+                        double a, b;
+                        const char* reason = "parameters should be numbers";
+
+                        if (parse_number(argv[p + 2], &a) || parse_number(argv[p + 3], &b) ||
+                            (reason = filter_check(argv[p + 1], a, b)) != NULL)
+                        {
+                            std::cerr << "Failed to parse argument [" << argv[p] << " " << argv[p + 1] << " " << argv[p + 2] << " " << argv[p + 3] << "], " << reason << std::endl;
+                            exit(1);
+                        }
+                        newCAM.get()->filterAdd(filter_create(argv[p + 1], a, b));
                         p += 4;
                     }
-                    else if (!strcmp(argv[p + 1], "exp1"))
+                    else if (!strcmp(argv[p], "freed") && (p + 1) < argc)
                     {
-                        newCAM.get()->filterAdd(new filter_exp1(atof(argv[p + 2]), atof(argv[p + 3])));
-                        p += 4;
+                        newCAM.get()->freedAdd(argv[p + 1]);
+                        p += 2;
                     }
-                    else if (!strcmp(argv[p + 1], "exp1dyn"))
+                    else if (!strcmp(argv[p], "coord") && (p + 1) < argc && coord_find(argv[p + 1]) >= 0)
                     {
-                        newCAM.get()->filterAdd(new filter_exp1dyn(atof(argv[p + 2]), atof(argv[p + 3])));
-                        p += 4;
+                        newCAM.get()->coordSetup(coord_find(argv[p + 1]));
+                        p += 2;
                     }
-                    else if (!strcmp(argv[p + 1], "exp1pasha"))
+                    else if (!strcmp(argv[p], "delay") && (p + 1) < argc && vrpn_Tracker_Camera::parseDelay(argv[p + 1]) >= 0.0)
                     {
-                        newCAM.get()->filterAdd(new filter_exp1pasha(atof(argv[p + 2]), atof(argv[p + 3])));
+                        newCAM.get()->delaySetup(vrpn_Tracker_Camera::parseDelay(argv[p + 1]));
+                        p += 2;
+                    }
+                    else if (!strcmp(argv[p], "dropout") && (p + 3) < argc)    // 3 arguments: dropout hold|extrapolate <max ms> <blend ms>
+                    {
+                        if (!strcmp(argv[p + 1], "hold"))
+                            newCAM.get()->dropoutSetup(CAM_DROPOUT_HOLD, atof(argv[p + 2]) / 1000.0, atof(argv[p + 3]) / 1000.0);
+                        else if (!strcmp(argv[p + 1], "extrapolate"))
+                            newCAM.get()->dropoutSetup(CAM_DROPOUT_EXTRAPOLATE, atof(argv[p + 2]) / 1000.0, atof(argv[p + 3]) / 1000.0);
+                        else
+                            break;
                         p += 4;
                     }
+                    else if (!strcmp(argv[p], "track") && (p + 2) < argc && !strcmp(argv[p + 2], "auto"))   // 2 arguments: track <TRACKER SERIAL> auto
+                    {
+                        q_vec_type offset_pos = { 0.0, 0.0, 0.0 };
+                        q_type offset_quat = { 0.0, 0.0, 0.0, 1.0 };
+                        newCAM.get()->trackerAdd(argv[p + 1], offset_pos, offset_quat, 1);
+                        p += 3;
+                    }
+                    else if (!strcmp(argv[p], "track") && (p + 7) < argc)   // 7 arguments: track <TRACKER SERIAL> <x> <y> <z> <yaw> <pitch> <roll>
+                    {
+                        q_vec_type offset_pos;
+                        q_type offset_quat;
+                        offset_pos[0] = atof(argv[p + 2]);
+                        offset_pos[1] = atof(argv[p + 3]);
+                        offset_pos[2] = atof(argv[p + 4]);
+                        q_from_euler(offset_quat,
+                            atof(argv[p + 5]) * 3.1415926 / 180.0,
+                            atof(argv[p + 6]) * 3.1415926 / 180.0,
+                            atof(argv[p + 7]) * 3.1415926 / 180.0);
+                        newCAM.get()->trackerAdd(argv[p + 1], offset_pos, offset_quat, 0);
+                        p += 8;
+                    }
                     else
                         break;
                 }
 
-                /* check if dst for free-d specified */
-                while (p < argc && !strcmp(argv[p], "freed") && (p + 1) <= argc)
-                {
-                    newCAM.get()->freedAdd(argv[p + 1]);
-                    p += 2;
-                }
-
                 cameras.push_back(std::move(newCAM));
             }
             else
@@ -125,12 +302,61 @@ vrpn_Server_OpenVR::vrpn_Server_OpenVR(int argc, char *argv[])
         connection = vrpn_create_server_connection(connectionName.c_str());
     }
 
+    // aggregate trackers, pinned sensors are reserved before anything appears
+    if (aggregate_cameras_name != "")
+    {
+        aggregate_cameras = std::make_unique<vrpn_Tracker_Aggregate>(aggregate_cameras_name, connection);
+        for (const auto& ci : cameras)
+        {
+            auto pin = sensor_pins.find(ci->getName());
+            aggregate_cameras->sensorAdd(ci->getName(), pin != sensor_pins.end() ? pin->second : ci->getIdx());
+        }
+    }
+    if (aggregate_devices_name != "")
+    {
+        aggregate_devices = std::make_unique<vrpn_Tracker_Aggregate>(aggregate_devices_name, connection);
+        for (const auto& pin : sensor_pins)
+            if (!aggregate_cameras || aggregate_cameras->sensorFind(pin.first) < 0)
+                aggregate_devices->sensorAdd(pin.first, pin.second);
+    }
+
+    // register cameras in shared memory
+    if (shmem)
+        for (const auto& ci : cameras)
+            shmem->setCamera(ci->getIdx(), ci->getName(), ci->getTrackerSerial());
+    if (recorder)
+        for (const auto& ci : cameras)
+            recorder->setSource(FR_KIND_CAMERA, ci->getIdx(), ci->getName());
+
+    for (const auto& ci : cameras)
+        ci->derivativesSetup(derivatives);
+
+    // full rate is known only after all options
+    if (idle_interval > 0)
+        poller = std::make_unique<adaptive_poll>(sleep_interval, idle_interval, idle_static);
+
+    // one pacer thread serves paced FreeD targets of all cameras
+    for (const auto& ci : cameras)
+        if (ci->freedPaced())
+        {
+            if (!pacer)
+                pacer = std::make_unique<packet_pacer>();
+            ci->pacerSetup(pacer.get());
+        }
+
     console_setup(&console_in, &console_out);
+
+    // helper threads are running already and keep normal scheduling
+    if (realtime.priority > 0 || realtime.cpu >= 0 || realtime.lock)
+    {
+        realtime_failed = realtime_apply(&realtime, realtime_report);
+        std::cerr << "realtime self-check:" << std::endl << realtime_report;
+    }
 }
 
 
 vrpn_Server_OpenVR::~vrpn_Server_OpenVR() {
-    vr::VR_Shutdown();
+    openvr.reset();
     if (connection) {
         connection->removeReference();
         connection = NULL;
@@ -138,43 +364,148 @@ vrpn_Server_OpenVR::~vrpn_Server_OpenVR() {
 }
 
 void vrpn_Server_OpenVR::mainloop() {
-    char *buf = NULL, press;
-    int ref_tracker_idx = -1;
+    char press;
+    vr::TrackedDeviceIndex_t ref_tracker_idx = vr::k_unTrackedDeviceIndexInvalid;
     struct timeval timestamp;
+    uint64_t allocs = alloc_count();
+    uint64_t faults = realtime_report.empty() ? 0 : realtime_page_faults();
+
+    discovery = false;
 
     press = console_keypress(console_in);
     if (press >= '0' && press <= '9')
-        ref_tracker_idx = press - '0';
+        ref_tracker_idx = (vr::TrackedDeviceIndex_t)(press - '0');
 
     // Get Tracking Information
     vrpn_gettimeofday(&timestamp, NULL);
+    if (recorder)
+    {
+        // tick after idle one is late on purpose
+        if (poller)
+            recorder->tickSlack(poller->getInterval() > sleep_interval ? (poller->getInterval() - sleep_interval) / 1000.0 : 0.0);
+        recorder->tickBegin(&timestamp);
+        if (press == 'r' || press == 'R')
+            recorder->trigger(FR_TRIGGER_KEY);
+    }
     vr::TrackedDevicePose_t m_rTrackedDevicePose[vr::k_unMaxTrackedDeviceCount];
-    vr->GetDeviceToAbsoluteTrackingPose(    /// https://github.com/ValveSoftware/openvr/wiki/IVRSystem::GetDeviceToAbsoluteTrackingPose
-        vr::TrackingUniverseStanding,
-        0 /*float fPredictedSecondsToPhotonsFromNow*/,
-        m_rTrackedDevicePose,
-        vr::k_unMaxTrackedDeviceCount
-    );
+    vr::TrackedDeviceIndex_t devices_count = 0;
+    if (!vr)
+        vr = openvr->get();
+    if (vr)
+    {
+        bool quit = false;
+
+        vr->GetDeviceToAbsoluteTrackingPose(    /// https://github.com/ValveSoftware/openvr/wiki/IVRSystem::GetDeviceToAbsoluteTrackingPose
+            vr::TrackingUniverseStanding,
+            0 /*float fPredictedSecondsToPhotonsFromNow*/,
+            m_rTrackedDevicePose,
+            vr::k_unMaxTrackedDeviceCount
+        );
+        devices_count = vr::k_unMaxTrackedDeviceCount;
+
+        // watch for runtime quit, deliver button events to controllers
+        vr::VREvent_t event;
+        while (vr->PollNextEvent(&event, sizeof(event)))
+        {
+            if (event.eventType == vr::VREvent_Quit)
+            {
+                quit = true;
+                continue;
+            }
+            if (!input_events)
+                continue;
+            auto dev_srch = devices.find(event.trackedDeviceIndex);
+            if (dev_srch != devices.end())
+                dev_srch->second->inputEvent(&event, &timestamp);
+        }
+
+        if (quit)
+        {
+            openvrDetach();
+            devices_count = 0;
+        }
+    }
 
     // setup cusrsor to top
-    SetConsoleCursorPosition(console_out, { 0, 0 });
+    console_home(console_out);
 //    console_cls(GetStdHandle(STD_ERROR_HANDLE));
 //    console_cls(GetStdHandle(STD_OUTPUT_HANDLE));
 
     // show built info
-    buf = NULL;
-    asprintf(&buf, "VRPN/FREE-D for StreamVR. api %s, app built [" __DATE__ " " __TIME__ "]", vr->GetRuntimeVersion());
-    console_put(buf);
-    if (buf) free(buf);
+    console_printf("VRPN/FREE-D for StreamVR. api %s, app built [" __DATE__ " " __TIME__ "]", vr ? vr->GetRuntimeVersion() : "-");
+    if (!vr)
+    {
+        char error[256];
+        openvr->getError(error, sizeof(error));
+        console_printf("OpenVR runtime not attached, attempt %ld, retry in %.1f s, %d devices detached: %s",
+            openvr->getAttempts(), openvr->getRetryIn(), (int)detached_devices.size(), error);
+    }
+    else if (openvr->getAttaches() > 1)
+        console_printf("OpenVR runtime reattached %ld times", openvr->getAttaches() - 1);
+    if (shmem)
+    {
+        console_printf("shared memory [%s] %s", shmem->getName().c_str(), shmem->isOpen() ? "published" : "FAILED");
+    }
+    if (peer_tx)
+    {
+        console_printf("peer node %u => %s %s", peer_tx->getNode(), peer_tx->getTarget().c_str(), peer_tx->isOpen() ? "" : "FAILED");
+    }
+    for (const auto& bt : batch_targets)
+    {
+        console_printf("batch => %s %s", bt->getTarget().c_str(), bt->isOpen() ? "" : "FAILED");
+    }
+    if (aggregate_devices)
+        aggregateShow(aggregate_devices.get());
+    if (aggregate_cameras)
+        aggregateShow(aggregate_cameras.get());
+    if (pacer)
+    {
+        console_printf("FreeD pacer: sent %ld, errors %ld, late %ld (max %.3f ms), overflows %ld",
+            pacer->getSent(), pacer->getErrors(), pacer->getLate(), pacer->getLatenessMax() * 1000.0, pacer->getOverflows());
+    }
+    if (recorder)
+    {
+        char last[512];
+        recorder->getLastDump(last, sizeof(last));
+        console_printf("flight recorder [%s] %.1f s, 'r' to dump, dumps %ld %s", recorder->getPrefix().c_str(), recorder->getSeconds(), recorder->getDumps(), last);
+    }
+    if (!realtime_report.empty())
+    {
+        const char *line, *end;
+
+        console_printf("realtime: %s, page faults: last tick %llu, steady state %llu", realtime_failed ? "INCOMPLETE" : "applied",
+            (unsigned long long)fault_tick, (unsigned long long)fault_steady);
+        for (line = realtime_report.c_str(); (end = strchr(line, '\n')) != NULL; line = end + 1)
+            console_printf("        %.*s", (int)(end - line), line);
+    }
+    if (poller)
+    {
+        console_printf("poll: %s, %d ms, idle %.0f%% of time, wakeups %ld, wakeup gap last %.1f ms, max %.1f ms",
+            adaptive_poll::getModeName(poller->getMode()), poller->getInterval(), poller->getIdleShare() * 100.0,
+            poller->getWakeups(), poller->getWakeupGapLast() * 1000.0, poller->getWakeupGapMax() * 1000.0);
+    }
+    if (alloc_count_enabled())
+        console_printf("heap allocations: last tick %llu, steady state %llu in %ld ticks",
+            (unsigned long long)alloc_tick, (unsigned long long)alloc_steady, alloc_steady_ticks);
     console_put("");
 
-    for (vr::TrackedDeviceIndex_t unTrackedDevice = 0; unTrackedDevice < vr::k_unMaxTrackedDeviceCount; unTrackedDevice++) {
+    peer_poses.clear();
+
+    for (vr::TrackedDeviceIndex_t unTrackedDevice = 0; unTrackedDevice < devices_count; unTrackedDevice++) {
         const char* state = "Running_OK";
         int f_update_data = 1;
         vr::TrackedDevicePose_t* pose = &m_rTrackedDevicePose[unTrackedDevice];
 
         if (!pose->bDeviceIsConnected)
+        {
+            auto dev_srch = devices.find(unTrackedDevice);
+            if (dev_srch != devices.end())
+            {
+                dev_srch->second->setTrackingState(pose->eTrackingResult, false);
+                dev_srch->second->reportKeepalive(&timestamp);
+            }
             continue;
+        }
 
         if (!pose->bPoseIsValid) {
             state = " !bPoseIsValid";
@@ -193,62 +524,106 @@ void vrpn_Server_OpenVR::mainloop() {
         }
 
 
-        // get device class
-        vr::ETrackedDeviceClass device_class_id = vr->GetTrackedDeviceClass(unTrackedDevice);
-        const std::string device_class_name = getDeviceClassName(device_class_id);
-
-        // find serial
-        std::string device_serial = getDeviceSerial(unTrackedDevice, vr.get());
-
-        // build name
-        const std::string device_name = "openvr/" + device_class_name + "/" + (device_serial == "" ? std::to_string(unTrackedDevice) : device_serial);
-
-        /* output name */
-        buf = NULL;  asprintf(&buf, "[%2d] => %-40s | %-40s", unTrackedDevice, device_name.c_str(), state);
-        console_put(buf);
-        if (buf) free(buf);
-
-        /* create new device or get early added */
+        /* create new device or get early added, names are built once on discovery */
         vrpn_Tracker_OpenVR *dev{ nullptr };
         auto dev_srch = devices.find(unTrackedDevice);
         if (dev_srch == devices.end())
         {
             std::unique_ptr<vrpn_Tracker_OpenVR> newDEV;
 
-            switch (device_class_id)
+            // get device class
+            vr::ETrackedDeviceClass device_class_id = vr->GetTrackedDeviceClass(unTrackedDevice);
+            const std::string device_class_name = getDeviceClassName(device_class_id);
+
+            // find serial
+            std::string device_serial = getDeviceSerial(unTrackedDevice, vr);
+
+            // build name
+            const std::string device_name = "openvr/" + device_class_name + "/" + (device_serial == "" ? std::to_string(unTrackedDevice) : device_serial);
+
+            // device known before runtime restart keeps its VRPN sender and clients
+            auto park_srch = detached_devices.find(device_name);
+            if (park_srch != detached_devices.end())
+            {
+                newDEV = std::move(park_srch->second);
+                newDEV->attach(vr, unTrackedDevice);
+                detached_devices.erase(park_srch);
+            }
+            else switch (device_class_id)
             {
                 case vr::TrackedDeviceClass_GenericTracker:     /// https://github.com/ValveSoftware/openvr/wiki/IVRSystem_Overview
                 case vr::TrackedDeviceClass_TrackingReference:
                 case vr::TrackedDeviceClass_HMD:
-                    newDEV = std::make_unique<vrpn_Tracker_OpenVR_HMD>(device_name, connection, vr.get(), unTrackedDevice);
+                    newDEV = std::make_unique<vrpn_Tracker_OpenVR_HMD>(device_name, connection, vr, unTrackedDevice);
                     break;
 
                 case vr::TrackedDeviceClass_Controller:
-                    newDEV = std::make_unique<vrpn_Tracker_OpenVR_Controller>(device_name, connection, vr.get(), unTrackedDevice);
+                    newDEV = std::make_unique<vrpn_Tracker_OpenVR_Controller>(device_name, connection, vr, unTrackedDevice, input_events);
                     break;
 
                 default:
-                    newDEV = std::make_unique<vrpn_Tracker_OpenVR>(device_name, connection, vr.get(), unTrackedDevice);
+                    newDEV = std::make_unique<vrpn_Tracker_OpenVR>(device_name, connection, vr, unTrackedDevice);
             }
 
             dev = newDEV.get();
+            dev->setSerial(device_serial);
+            dev->setDerivatives(derivatives);
+            discovery = true;
+            auto policy_srch = report_policies.find(device_class_id);
+            if (policy_srch != report_policies.end())
+                dev->setReportPolicy(policy_srch->second);
             devices[unTrackedDevice] = std::move(newDEV);
+            if (device_serial != "")
+                devices_by_serial[device_serial] = dev;
+
+            if (shmem)
+                shmem->setDevice(unTrackedDevice, device_name, device_serial);
+            if (recorder)
+                recorder->setSource(FR_KIND_DEVICE, unTrackedDevice, device_serial == "" ? device_name : device_serial);
         }
         else
             dev = dev_srch->second.get();
 
+        /* output name */
+        console_printf("[%2d] => %-40s | %-40s", unTrackedDevice, dev->getName().c_str(), state);
+
+        dev->setTrackingState(pose->eTrackingResult, pose->bPoseIsValid);
+
         /* update tracking data */
         if (f_update_data)
         {
             dev->updateTracking(pose);
             dev->mainloop();
-        };
+        }
+        else
+            dev->reportKeepalive(&timestamp);
 
         /* display position and rot */
         q_vec_type vec;
         dev->getPosition(vec);
         q_type quat;
         dev->getRotation(quat);
+        if (shmem)
+            shmem->publishDevice(unTrackedDevice, vec, quat, &timestamp, pose->eTrackingResult, f_update_data);
+        if (recorder)
+            recorder->device(unTrackedDevice, vec, quat, pose->eTrackingResult, f_update_data);
+        if (poller)
+            poller->pose(dev, vec, quat, f_update_data);
+        if (aggregate_devices && f_update_data)
+            aggregate_devices->update(aggregate_devices->sensorAdd(dev->getSerial() != "" ? dev->getSerial() : dev->getName()), vec, quat);
+        if (peer_tx && dev->getSerial() != "")
+        {
+            peer_pose_t pp;
+            memset(&pp, 0, sizeof(pp));
+            strncpy(pp.serial, dev->getSerial().c_str(), PEER_SERIAL_LEN - 1);
+            pp.device_class = dev->getDeviceClass();
+            pp.tracking = pose->eTrackingResult;
+            pp.valid = f_update_data;
+            q_vec_copy(pp.pos, vec);
+            q_copy(pp.quat, quat);
+            pp.timestamp = (int64_t)timestamp.tv_sec * 1000000 + timestamp.tv_usec;
+            peer_poses.push_back(pp);
+        }
         q_vec_type yawPitchRoll;
         q_to_euler(yawPitchRoll, quat); // quaternion to euler for display
         /*
@@ -258,31 +633,15 @@ void vrpn_Server_OpenVR::mainloop() {
             [1] - Q_PITCH - rotation about Y
             [2] - Q_ROLL - rotation about X
         */
-        buf = NULL; asprintf(&buf, "        pos=[%8.4f, %8.4f, %8.4f], euler=[Yaw/Z=%8.4f, Pitch/Y=%8.4f, Roll/X=%8.4f]",
+        console_printf("        pos=[%8.4f, %8.4f, %8.4f], euler=[Yaw/Z=%8.4f, Pitch/Y=%8.4f, Roll/X=%8.4f]",
             vec[0], vec[1], vec[2],
             yawPitchRoll[0] * 180.0 / 3.1415926,
             yawPitchRoll[1] * 180.0 / 3.1415926,
             yawPitchRoll[2] * 180.0 / 3.1415926);
-        console_put(buf);
-        if (buf) free(buf);
 #if 0
-        buf = NULL; asprintf(&buf, "        spd=[%8.4f, %8.4f, %8.4f]",
+        console_printf("        spd=[%8.4f, %8.4f, %8.4f]",
             pose->vVelocity.v[0], pose->vVelocity.v[1], pose->vVelocity.v[2]);
-        console_put(buf);
-        if (buf) free(buf);
 #endif
-        /* find camera assiciated with that tracker */
-        for (const auto& ci : cameras)
-        {
-            /* check for serial */
-            if (ci->getTrackerSerial() != device_serial)
-                continue;
-
-            /* do some precomputation */
-            ci->updateTracking(vec, quat, reference_position, reference_quat, reference_point, &timestamp);
-            ci->mainloop();
-        }
-
         /* empty line */
         console_put("");
 
@@ -294,15 +653,105 @@ void vrpn_Server_OpenVR::mainloop() {
         }
     }
 
+    /* forward own devices to aggregator, merge devices of peers */
+    if (peer_tx)
+    {
+        int64_t now = (int64_t)timestamp.tv_sec * 1000000 + timestamp.tv_usec;
+        peer_tx->send(peer_poses.data(), (int)peer_poses.size(), now);
+        peer_tx->poll();
+    }
+    if (peer_rx)
+        peerReceive(&timestamp);
+
+    /* update cameras from fused poses of their trackers */
+    for (const auto& ci : cameras)
+    {
+        int t, found = 0, used;
+        vr::ETrackingResult cam_tracking = vr::TrackingResult_Uninitialized;
+        q_vec_type vec = { 0.0, 0.0, 0.0 };
+        q_type quat = { 0.0, 0.0, 0.0, 1.0 };
+
+        for (t = 0; t < ci->getTrackersCount(); t++)
+        {
+            q_vec_type trk_vec;
+            q_type trk_quat;
+
+            auto dev_srch = devices_by_serial.find(ci->getTrackerSerial(t));
+            if (dev_srch == devices_by_serial.end())
+            {
+                ci->trackerPose(t, trk_vec, trk_quat, 0);
+                continue;
+            }
+
+            vrpn_Tracker_OpenVR *dev = dev_srch->second;
+            dev->getPosition(trk_vec);
+            dev->getRotation(trk_quat);
+            ci->trackerPose(t, trk_vec, trk_quat, dev->isTracking());
+            if (!t)
+            {
+                /* primary tracker pose is used until anything is fused */
+                q_vec_copy(vec, trk_vec);
+                q_copy(quat, trk_quat);
+                cam_tracking = dev->getTrackingResult();
+            }
+            found++;
+        }
+
+        /* none of trackers ever seen */
+        if (!found)
+            continue;
+
+        used = ci->trackerFuse(vec, quat);
+        if (used)
+            cam_tracking = vr::TrackingResult_Running_OK;
+        else if (cam_tracking == vr::TrackingResult_Running_OK)
+            cam_tracking = vr::TrackingResult_Running_OutOfRange;
+
+        /* hold or extrapolate pose while trackers are lost */
+        ci->dropoutProcess(vec, quat, used > 0, &timestamp);
+
+        /* do some precomputation */
+        ci->updateTracking(vec, quat, reference_position, reference_quat, reference_point, &timestamp);
+        ci->mainloop();
+
+        if (shmem)
+        {
+            q_vec_type cam_vec;
+            q_type cam_quat;
+            ci->getPosition(cam_vec);
+            ci->getRotation(cam_quat);
+            shmem->publishCamera(ci->getIdx(), cam_vec, cam_quat, &timestamp, cam_tracking, used > 0, ci->getTrackingState());
+        }
+
+        if (aggregate_cameras)
+        {
+            q_vec_type cam_vec;
+            q_type cam_quat;
+            ci->getReportedPose(cam_vec, cam_quat);
+            aggregate_cameras->update(aggregate_cameras->sensorFind(ci->getName()), cam_vec, cam_quat);
+        }
+
+        if (recorder)
+        {
+            q_vec_type cam_vec;
+            q_type cam_quat;
+            ci->getPosition(cam_vec);
+            ci->getRotation(cam_quat);
+            recorder->camera(ci->getIdx(), cam_vec, cam_quat, ci->getTrackingState(), ci->getFreedSent(), ci->getFreedErrors());
+        }
+    }
+
+    /* all cameras of tick in one datagram */
+    for (const auto& bt : batch_targets)
+        bt->send(cameras, &timestamp);
+
     console_put("Virtual space:");
     console_put("");
 
     {
         /* display reference point */
-        buf = NULL; asprintf(&buf, "        ref=[%8.4f, %8.4f, %8.4f]",
+        console_printf("        ref=[%8.4f, %8.4f, %8.4f]",
             reference_point[0], reference_point[1], reference_point[2]);
-        console_put(buf);
-        if (buf) free(buf);
 
         /* display reference position and rot */
         q_vec_type vec;
@@ -318,13 +767,11 @@ void vrpn_Server_OpenVR::mainloop() {
             [1] - Q_PITCH - rotation about Y
             [2] - Q_ROLL - rotation about X
         */
-        buf = NULL; asprintf(&buf, "        pos=[%8.4f, %8.4f, %8.4f], euler=[Yaw/Z=%8.4f, Pitch/Y=%8.4f, Roll/X=%8.4f]",
+        console_printf("        pos=[%8.4f, %8.4f, %8.4f], euler=[Yaw/Z=%8.4f, Pitch/Y=%8.4f, Roll/X=%8.4f]",
             vec[0], vec[1], vec[2],
             yawPitchRoll[0] * 180.0 / 3.1415926,
             yawPitchRoll[1] * 180.0 / 3.1415926,
             yawPitchRoll[2] * 180.0 / 3.1415926);
-        console_put(buf);
-        if (buf) free(buf);
 
         /* empty line */
         console_put("");
@@ -337,9 +784,17 @@ void vrpn_Server_OpenVR::mainloop() {
     for (const auto& ci : cameras)
     {
         /* output name */
-        buf = NULL;  asprintf(&buf, "        %-40s | %-40s", ci->getName().c_str(), ci->getTrackerSerial().c_str());
-        console_put(buf);
-        if (buf) free(buf);
+        console_printf("        %-40s | %-40s | %s", ci->getName().c_str(), ci->getTrackerSerial().c_str(), vrpn_Tracker_Camera::getTrackingStateName(ci->getTrackingState()));
+
+        /* additional trackers */
+        for (int t = 1; t < ci->getTrackersCount(); t++)
+        {
+            console_printf("        %-40s | %-40s residual=%6.2fmm", "", ci->getTrackerSerial(t).c_str(), ci->getTrackerResidual(t) * 1000.0);
+        }
+
+        /* spikes removed by outlier gate */
+        if (ci->getFilterRejected() >= 0)
+            console_printf("        %-40s | rejected=%ld", "", ci->getFilterRejected());
 
         /* display position and rot */
         q_vec_type vec;
@@ -355,13 +810,11 @@ void vrpn_Server_OpenVR::mainloop() {
             [1] - Q_PITCH - rotation about Y
             [2] - Q_ROLL - rotation about X
         */
-        buf = NULL; asprintf(&buf, "        pos=[%8.4f, %8.4f, %8.4f], euler=[Yaw/Z=%8.4f, Pitch/Y=%8.4f, Roll/X=%8.4f]",
+        console_printf("        pos=[%8.4f, %8.4f, %8.4f], euler=[Yaw/Z=%8.4f, Pitch/Y=%8.4f, Roll/X=%8.4f]",
             vec[0], vec[1], vec[2],
             yawPitchRoll[0] * 180.0 / 3.1415926,
             yawPitchRoll[1] * 180.0 / 3.1415926,
             yawPitchRoll[2] * 180.0 / 3.1415926);
-        console_put(buf);
-        if (buf) free(buf);
 
         /* empty line */
         console_put("");
@@ -370,6 +823,21 @@ void vrpn_Server_OpenVR::mainloop() {
     /* empty line */
     console_put("");
 #endif
+    if (shmem)
+        shmem->tick();
+
+    // poses of aggregate sensors go back-to-back before connection flush
+    if (aggregate_devices)
+    {
+        aggregate_devices->flush(&timestamp);
+        aggregate_devices->mainloop();
+    }
+    if (aggregate_cameras)
+    {
+        aggregate_cameras->flush(&timestamp);
+        aggregate_cameras->mainloop();
+    }
+
     // Send and receive all messages.
     connection->mainloop();
 
@@ -377,6 +845,167 @@ void vrpn_Server_OpenVR::mainloop() {
     if (!connection->doing_okay()) {
         std::cerr << "Connection is not doing ok. Should we bail?" << std::endl;
     }
+
+    /* slow down when nobody is served or nothing moves; any output counts as
+       consumer, shared memory readers are not visible so segment always does */
+    if (poller)
+    {
+        bool consumers = connection->connected() || !batch_targets.empty() || peer_tx || (shmem && shmem->isOpen());
+        for (const auto& ci : cameras)
+            consumers = consumers || ci->getFreedTargetsCount() > 0;
+        poller->tick(timestamp.tv_sec + timestamp.tv_usec / 1000000.0, consumers);
+    }
+
+    if (recorder)
+    {
+        long sent = 0, errors = 0;
+        for (const auto& bt : batch_targets)
+        {
+            sent += bt->getSent();
+            errors += bt->getErrors();
+        }
+        recorder->tickEnd(sent, errors);
+    }
+
+    alloc_tick = alloc_count() - allocs;
+    if (!realtime_report.empty())
+        fault_tick = realtime_page_faults() - faults;
+    if (!discovery)
+    {
+        alloc_steady += alloc_tick;
+        alloc_steady_ticks++;
+        fault_steady += fault_tick;
+    }
+}
+
+/* interval to next tick, ms: sleep_interval or idle one */
+int vrpn_Server_OpenVR::getPollInterval()
+{
+    return poller ? poller->getInterval() : sleep_interval;
+}
+
+/*
+    OpenVR runtime quit: devices are not destroyed, they are parked by name
+    with tracking lost, so VRPN clients stay connected and cameras keep
+    calibration and go through dropout handling. Parked device is resumed
+    when it is discovered again after reattach. Shared memory slots keep
+    last pose, but are marked invalid, they are not updated until then.
+*/
+void vrpn_Server_OpenVR::openvrDetach()
+{
+    struct timeval timestamp;
+
+    vrpn_gettimeofday(&timestamp, NULL);
+
+    for (auto& it : devices)
+    {
+        vrpn_Tracker_OpenVR *dev = it.second.get();
+
+        dev->setTrackingState(vr::TrackingResult_Uninitialized, false);
+        if (shmem)
+        {
+            q_vec_type pos;
+            q_type quat;
+            dev->getPosition(pos);
+            dev->getRotation(quat);
+            shmem->publishDevice(it.first, pos, quat, &timestamp, vr::TrackingResult_Uninitialized, 0);
+        }
+        dev->attach(nullptr, vr::k_unTrackedDeviceIndexInvalid);
+        detached_devices[dev->getName()] = std::move(it.second);
+    }
+    devices.clear();
+    discovery = true;
+
+    vr->AcknowledgeQuit_Exiting();
+    openvr->detach();
+    vr = nullptr;
+}
+
+/* sensor mapping of aggregate tracker in one line: <sensor>=<serial or name> */
+void vrpn_Server_OpenVR::aggregateShow(vrpn_Tracker_Aggregate* agg)
+{
+    char line[1024];
+    int s, len;
+
+    len = snprintf(line, sizeof(line), "aggregate %s:", agg->getName().c_str());
+    for (s = 0; s < agg->getSensorsCount() && len < (int)sizeof(line); s++)
+        if (agg->getSensorKey(s) != "")
+            len += snprintf(line + len, sizeof(line) - len, " %d=%s", s, agg->getSensorKey(s).c_str());
+
+    console_printf("%s", line);
+}
+
+void vrpn_Server_OpenVR::peerReceive(struct timeval *timestamp)
+{
+    int64_t now = (int64_t)timestamp->tv_sec * 1000000 + timestamp->tv_usec;
+
+    peer_poses.clear();
+    peer_rx->poll(now, peer_poses);
+
+    /* local devices share namespace with peer devices and take precedence */
+    for (auto& pp : peer_poses)
+    {
+        vrpn_Tracker_Peer *dev;
+        const char *serial = pp.serial;
+
+        auto dev_srch = peer_devices.find(serial);
+        if (dev_srch == peer_devices.end())
+        {
+            if (!serial[0] || devices_by_serial.find(serial) != devices_by_serial.end())
+                continue;
+
+            const std::string device_name = "openvr/" + getDeviceClassName((vr::ETrackedDeviceClass)pp.device_class) + "/" + serial;
+
+            std::unique_ptr<vrpn_Tracker_Peer> newDEV = std::make_unique<vrpn_Tracker_Peer>(device_name, connection, (vr::ETrackedDeviceClass)pp.device_class, pp.node);
+            auto policy_srch = report_policies.find((vr::ETrackedDeviceClass)pp.device_class);
+            if (policy_srch != report_policies.end())
+                newDEV->setReportPolicy(policy_srch->second);
+            dev = newDEV.get();
+            peer_devices[serial] = std::move(newDEV);
+            discovery = true;
+            devices_by_serial[serial] = dev;
+        }
+        else
+            dev = dev_srch->second.get();
+
+        dev->updateTracking(&pp);
+        if (poller)
+            poller->pose(dev, pp.pos, pp.quat, pp.valid);
+        if (aggregate_devices && pp.valid)
+            aggregate_devices->update(aggregate_devices->sensorAdd(dev->getSerial() != "" ? dev->getSerial() : dev->getName()), pp.pos, pp.quat);
+    }
+
+    console_put("Peers:");
+    console_put("");
+
+    console_printf("        listening on UDP port %d %s", peer_rx->getPort(), peer_rx->isOpen() ? "" : "FAILED");
+
+    for (const auto& it : peer_rx->getPeers())
+    {
+        const peer_stat_t& st = it.second;
+
+        console_printf("        node %-4u %-21s offset=%9.3fms%s rtt=%7.3fms latency=%7.3fms (max %7.3f) age=%7.3fms lost=%ld",
+            st.node, st.addr.c_str(), st.offset / 1000.0, st.synced ? "" : "?", st.rtt / 1000.0,
+            st.latency / 1000.0, st.latency_max / 1000.0, st.age / 1000.0, st.lost);
+    }
+
+    /* devices of silent peers are lost */
+    for (const auto& it : peer_devices)
+    {
+        vrpn_Tracker_Peer *dev = it.second.get();
+
+        if (now - dev->getLastUpdate() > PEER_TIMEOUT)
+        {
+            dev->setTrackingState(vr::TrackingResult_Running_OutOfRange, false);
+            dev->reportKeepalive(timestamp);
+        }
+
+        dev->mainloop();
+
+        console_printf("        node %-4u => %-40s | %s", dev->getNode(), dev->getName().c_str(), dev->isTracking() ? "Running_OK" : "not tracking");
+    }
+
+    console_put("");
 }
 
 const std::string vrpn_Server_OpenVR::getDeviceClassName(vr::ETrackedDeviceClass device_class_id)
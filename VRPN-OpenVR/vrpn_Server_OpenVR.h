@@ -10,6 +10,18 @@
 #include "vrpn_Tracker_OpenVR_HMD.h"
 #include "vrpn_Tracker_OpenVR_Controller.h"
 #include "vrpn_Tracker_Camera.h"
+#include "shmem_server.h"
+#include "peer_link.h"
+#include "batch_sender.h"
+#include "recorder.h"
+#include "openvr_link.h"
+#include "pacer.h"
+#include "realtime.h"
+#include "adaptive_poll.h"
+#include "vrpn_Tracker_Peer.h"
+#include "vrpn_Tracker_Aggregate.h"
+#include "console.h"
+#include "alloc_count.h"
 
 /// Sensor numbers in SteamVR and for tracking
 static const auto HMD_SENSOR = 0;
@@ -44,16 +56,45 @@ public:
 	vrpn_Server_OpenVR(int argc, char *argv[]);
 	~vrpn_Server_OpenVR();
 	void mainloop();
+    int getPollInterval();
     int sleep_interval;
     HANDLE console_in, console_out;
     static const std::string getDeviceClassName(vr::ETrackedDeviceClass device_class_id);
     static const std::string getDeviceSerial(vr::TrackedDeviceIndex_t trackedDeviceIndex, vr::IVRSystem * vr);
 private:
-	std::unique_ptr<vr::IVRSystem> vr{ nullptr };
+	vr::IVRSystem *vr{ nullptr };
+    std::unique_ptr<openvr_link> openvr{};
 	vrpn_Connection *connection;
     std::map<vr::TrackedDeviceIndex_t, std::unique_ptr<vrpn_Tracker_OpenVR>> devices{};
+    std::map<std::string, vrpn_Tracker_OpenVR*, std::less<>> devices_by_serial{};
+    std::map<std::string, std::unique_ptr<vrpn_Tracker_OpenVR>> detached_devices{};    // by name, kept while runtime is gone
+    std::unique_ptr<packet_pacer> pacer{};     // declared before cameras, they send through it
     std::list<std::unique_ptr<vrpn_Tracker_Camera>> cameras{};
     q_vec_type reference_point, reference_position;
     q_type reference_quat;
+    std::unique_ptr<shmem_server> shmem{};
+    std::unique_ptr<peer_sender> peer_tx{};
+    std::unique_ptr<peer_aggregator> peer_rx{};
+    std::list<std::unique_ptr<batch_sender>> batch_targets{};
+    std::unique_ptr<flight_recorder> recorder{};
+    std::map<std::string, std::unique_ptr<vrpn_Tracker_Peer>, std::less<>> peer_devices{};
+    std::vector<peer_pose_t> peer_poses{};
+    std::unique_ptr<vrpn_Tracker_Aggregate> aggregate_devices{}, aggregate_cameras{};
+    std::string aggregate_devices_name, aggregate_cameras_name;
+    std::map<std::string, int> sensor_pins{};  // device serial or camera name => aggregate sensor
+    void aggregateShow(vrpn_Tracker_Aggregate* agg);
+    void peerReceive(struct timeval *timestamp);
+    void openvrDetach();
+    bool discovery;                     // device was created during this tick
+    uint64_t alloc_tick, alloc_steady;  // heap allocations of last tick and of all ticks without discovery
+    long alloc_steady_ticks;
+    realtime_config_t realtime;         // priority 0, cpu -1, lock 0 - not requested
+    std::string realtime_report;        // result of every step, one per line
+    int realtime_failed;
+    uint64_t fault_tick, fault_steady;  // page faults of tracking thread, last tick and all ticks without discovery
+    std::unique_ptr<adaptive_poll> poller{};   // idle mode, set by "idle" option
+    bool input_events;
+    int derivatives;                    // DERIV_*, VRPN velocity/acceleration reports of devices and cameras
+    std::map<vr::ETrackedDeviceClass, report_policy_t> report_policies{};
 };
 
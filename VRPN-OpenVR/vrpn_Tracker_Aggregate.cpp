@@ -0,0 +1,98 @@
+#include "vrpn_Tracker_Aggregate.h"
+#include <iostream>
+
+vrpn_Tracker_Aggregate::vrpn_Tracker_Aggregate(const std::string& name, vrpn_Connection* connection) :
+	vrpn_Tracker(name.c_str(), connection), name(name)
+{
+	vrpn_Tracker::num_sensors = 0;
+}
+
+// sensor of key, existing one is kept, pinned index wins if it is free, otherwise next free
+int vrpn_Tracker_Aggregate::sensorAdd(const std::string& key, int sensor)
+{
+    auto srch = sensors.find(key);
+    if (srch != sensors.end())
+        return srch->second;
+
+    if (sensor < 0 || (sensor < (int)slots.size() && !slots[sensor].key.empty()))
+    {
+        if (sensor >= 0)
+            std::cerr << "Aggregate tracker [" << name << "] sensor " << sensor << " is taken, [" << key << "] gets next free" << std::endl;
+        for (sensor = 0; sensor < (int)slots.size() && !slots[sensor].key.empty(); sensor++)
+            ;
+    }
+
+    if (sensor >= (int)slots.size())
+    {
+        aggregate_sensor_t free_slot;
+        free_slot.updated = 0;
+        slots.resize(sensor + 1, free_slot);
+    }
+    slots[sensor].key = key;
+    slots[sensor].updated = 0;
+    sensors[key] = sensor;
+	vrpn_Tracker::num_sensors = (vrpn_int32)slots.size();
+
+    return sensor;
+}
+
+int vrpn_Tracker_Aggregate::sensorFind(const std::string& key)
+{
+    auto srch = sensors.find(key);
+
+    return srch == sensors.end() ? -1 : srch->second;
+}
+
+void vrpn_Tracker_Aggregate::update(int sensor, q_vec_type pos, q_type quat)
+{
+    if (sensor < 0 || sensor >= (int)slots.size())
+        return;
+
+    q_vec_copy(slots[sensor].pos, pos);
+    q_copy(slots[sensor].quat, quat);
+    slots[sensor].updated = 1;
+}
+
+// pack poses updated during tick back-to-back, connection sends them in one write
+void vrpn_Tracker_Aggregate::flush(struct timeval *tv)
+{
+    char msgbuf[1000];
+    vrpn_int32 len;
+    int s;
+
+    timestamp = *tv;
+    for (s = 0; s < (int)slots.size(); s++)
+    {
+        if (!slots[s].updated)
+            continue;
+        slots[s].updated = 0;
+
+        d_sensor = s;
+        q_vec_copy(pos, slots[s].pos);
+        q_copy(d_quat, slots[s].quat);
+        len = vrpn_Tracker::encode_to(msgbuf);
+        if (d_connection->pack_message(len, timestamp, position_m_id, d_sender_id, msgbuf, vrpn_CONNECTION_LOW_LATENCY)) {
+            std::cerr << " Can't write message";
+        }
+    }
+}
+
+void vrpn_Tracker_Aggregate::mainloop()
+{
+	vrpn_Tracker::server_mainloop();
+}
+
+const std::string& vrpn_Tracker_Aggregate::getName()
+{
+    return name;
+}
+
+int vrpn_Tracker_Aggregate::getSensorsCount()
+{
+    return (int)slots.size();
+}
+
+const std::string& vrpn_Tracker_Aggregate::getSensorKey(int sensor)
+{
+    return slots[sensor].key;
+}
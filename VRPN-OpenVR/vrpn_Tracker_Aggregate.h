@@ -0,0 +1,44 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <vrpn_Tracker.h>
+#include <quat.h>
+
+#define AGGREGATE_PIN_MAX   255     // highest sensor index configuration may pin (devices of several nodes)
+
+typedef struct
+{
+    std::string key;        // device serial or camera name, empty - free slot
+    q_vec_type pos;
+    q_type quat;
+    int updated;            // pose was set during current tick
+} aggregate_sensor_t;
+
+/*
+    One VRPN tracker with sensor per device or camera (e.g. openvr/all,
+    virtual/all), so client needs single remote for whole stage. Sensor
+    index of a key never changes while server runs: it is pinned by
+    configuration or assigned on first appearance. Poses are collected
+    during tick and packed back-to-back in flush(), so they leave in one
+    connection write.
+*/
+class vrpn_Tracker_Aggregate :
+	public vrpn_Tracker
+{
+public:
+	vrpn_Tracker_Aggregate(const std::string& name, vrpn_Connection* connection);
+	void mainloop();
+    int sensorAdd(const std::string& key, int sensor = -1);
+    int sensorFind(const std::string& key);
+    void update(int sensor, q_vec_type pos, q_type quat);
+    void flush(struct timeval *tv);
+    const std::string& getName();
+    int getSensorsCount();
+    const std::string& getSensorKey(int sensor);
+private:
+	std::string name;
+    std::map<std::string, int, std::less<>> sensors;
+    std::vector<aggregate_sensor_t> slots;
+};
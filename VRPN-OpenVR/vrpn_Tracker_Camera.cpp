@@ -2,6 +2,13 @@
 #include <openvr.h>
 #include <quat.h>
 #include <iostream>
+#include <string.h>
+#include <math.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#endif
 #include "FreeD.h"
 
 void vrpn_Tracker_Camera::filterAdd(filter_abstract* flt)
@@ -10,8 +17,21 @@ void vrpn_Tracker_Camera::filterAdd(filter_abstract* flt)
     filters_cnt++;
 };
 
+/* samples replaced by gating filters of chain, -1 if there is none */
+long vrpn_Tracker_Camera::getFilterRejected()
+{
+    long r, rejected = -1;
+    int f;
+
+    for (f = 0; f < filters_cnt; f++)
+        if ((r = filters_list[f]->getRejected()) >= 0)
+            rejected = (rejected < 0 ? 0 : rejected) + r;
+
+    return rejected;
+}
+
 vrpn_Tracker_Camera::vrpn_Tracker_Camera(int idx, const std::string& name, vrpn_Connection* connection, const std::string& tracker_serial, q_vec_type _arm) :
-	vrpn_Tracker(name.c_str(), connection), name(name), tracker_serial(tracker_serial), freed_socket(-1), idx(idx)
+	vrpn_Tracker(name.c_str(), connection), vrpn_Analog(name.c_str(), connection), name(name), tracker_serial(tracker_serial), freed_socket(-1), freed_sent(0), freed_errors(0), pacer(nullptr), idx(idx)
 {
     arm[0] = _arm[0];
     arm[1] = _arm[1];
@@ -19,9 +39,36 @@ vrpn_Tracker_Camera::vrpn_Tracker_Camera(int idx, const std::string& name, vrpn_
 
     filters_cnt = 0;
 
+    // camera space is UE4, stage pose starts at origin
+    q_vec_type zero_pos = { 0.0, 0.0, 0.0 };
+    q_type ident_quat = { 0.0, 0.0, 0.0, 1.0 };
+    q_vec_copy(stage_pos, zero_pos);
+    q_copy(stage_quat, ident_quat);
+    coordSetup(COORD_UE4);
+    delaySetup(0.0);
+    history_cnt = 0;
+    derivativesSetup(DERIV_NONE);
+
+    // primary tracker defines camera rig pose
+    q_vec_type zero = { 0.0, 0.0, 0.0 };
+    q_type ident = { 0.0, 0.0, 0.0, 1.0 };
+    trackerAdd(tracker_serial, zero, ident, 0);
+    fused = fused_cnt = 0;
+
+    // by default hold last pose forever and snap back on reacquisition
+    dropoutSetup(CAM_DROPOUT_HOLD, 0.0, 0.0);
+    tracking_state = CAM_TRACKING_OK;
+    live_cnt = 0;
+
     // Initialize the vrpn_Tracker
     // We track each device separately so this will only ever have one sensor
     vrpn_Tracker::num_sensors = 1;
+
+    // Initialize the vrpn_Analog: tracking state and number of fused trackers
+    vrpn_Analog::num_channel = 2;
+    for (auto i = 0; i < vrpn_Analog::num_channel; i++) {
+        vrpn_Analog::channel[i] = vrpn_Analog::last[i] = 0;
+    }
 }
 
 /*
@@ -40,34 +87,9 @@ vrpn_Tracker_Camera::vrpn_Tracker_Camera(int idx, const std::string& name, vrpn_
         +y - right
         +z - up
 
+    Conversion tables are in coord.h, camera pose is computed in UE4 space
+    and converted to convention of every output.
 */
-static inline void quat_openvr_to_ue4(q_type src, q_type& dst)
-{
-#if 0 // lets do preroate early
-    q_type prerot90, tmp;
-
-    q_from_euler(prerot90, 0, 0, -3.1415926 / 2.0); // double yaw, double pitch, double roll
-    q_mult(tmp, src, prerot90);
-
-    dst[0] = -tmp[2];
-    dst[1] = tmp[0];
-    dst[2] = tmp[1];
-    dst[3] = -tmp[3];
-#else
-    dst[0] = -src[2];
-    dst[1] = src[0];
-    dst[2] = src[1];
-    dst[3] = src[3];
-#endif
-}
-
-static inline void vec_openvr_to_ue4(q_vec_type src, q_vec_type& dst)
-{
-    dst[0] = -src[2];
-    dst[1] = src[0];
-    dst[2] = src[1];
-}
-
 void vrpn_Tracker_Camera::updateTracking(q_vec_type _tracker_pos, q_type _tracker_quat, q_vec_type reference_pos, q_type reference_quat, q_vec_type reference_point, struct timeval *tv)
 {
     // backup origin data sent to update tracking
@@ -83,7 +105,7 @@ void vrpn_Tracker_Camera::updateTracking(q_vec_type _tracker_pos, q_type _tracke
     q_vec_copy(tmp_tracker_pos, tracker_pos);
     q_copy(tmp_tracker_quat, tracker_quat);
     for (f = 0; f < filters_cnt; f++)
-        filters_list[f]->process_data(tmp_tracker_pos, tmp_tracker_quat);
+        filters_list[f]->process_data(tmp_tracker_pos, tmp_tracker_quat, tv->tv_sec + tv->tv_usec / 1000000.0);
     q_vec_copy(tracker_pos, tmp_tracker_pos);
     q_copy(tracker_quat, tmp_tracker_quat);
 
@@ -92,8 +114,8 @@ void vrpn_Tracker_Camera::updateTracking(q_vec_type _tracker_pos, q_type _tracke
     q_type ue4_tracker_quat, ue4_reference_quat;
 
     // translate all quats to UE4
-    quat_openvr_to_ue4(tracker_quat, ue4_tracker_quat);
-    quat_openvr_to_ue4(reference_quat, ue4_reference_quat);
+    coord_convert<COORD_OPENVR, COORD_UE4>::quat(tracker_quat, ue4_tracker_quat);
+    coord_convert<COORD_OPENVR, COORD_UE4>::quat(reference_quat, ue4_reference_quat);
 
     // cam re-rotation
     q_type i_ue4_reference_quat;
@@ -106,8 +128,8 @@ void vrpn_Tracker_Camera::updateTracking(q_vec_type _tracker_pos, q_type _tracke
 
     // translate all pos to UE4
 
-    vec_openvr_to_ue4(tracker_pos, ue4_tracker_pos);
-    vec_openvr_to_ue4(reference_pos, ue4_reference_pos);
+    coord_convert<COORD_OPENVR, COORD_UE4>::vec(tracker_pos, ue4_tracker_pos);
+    coord_convert<COORD_OPENVR, COORD_UE4>::vec(reference_pos, ue4_reference_pos);
 
     // find relative vector of movement
     q_vec_subtract(pos, ue4_tracker_pos, ue4_reference_pos);
@@ -131,76 +153,720 @@ void vrpn_Tracker_Camera::updateTracking(q_vec_type _tracker_pos, q_type _tracke
     q_xform(arm_vec, arm_quat, arm);
     q_vec_add(pos, pos, arm_vec);
 
+    // keep UE4 pose in history
+    q_vec_copy(stage_pos, pos);
+    q_copy(stage_quat, d_quat);
+    cam_pose_t& h = history[history_cnt++ % CAM_HISTORY_SLOTS];
+    h.t = tv->tv_sec + tv->tv_usec / 1000000.0;
+    q_vec_copy(h.pos, stage_pos);
+    q_copy(h.quat, stage_quat);
+
+    // report delayed pose in camera convention, timestamp stays tick time
+    if (delay > 0.0)
+        delayedPose(h.t - delay, pos, d_quat);
+    coord_out(pos, d_quat, pos, d_quat);
+
     // Pack message
 #if 0
-	vrpn_gettimeofday(&timestamp, NULL);
+	vrpn_gettimeofday(&vrpn_Tracker::timestamp, NULL);
 #else
-    timestamp.tv_sec = tv->tv_sec;
-    timestamp.tv_usec = tv->tv_usec;
+    vrpn_Tracker::timestamp.tv_sec = tv->tv_sec;
+    vrpn_Tracker::timestamp.tv_usec = tv->tv_usec;
 #endif
 	char msgbuf[1000];
 	vrpn_int32 len = vrpn_Tracker::encode_to(msgbuf);
-	if (d_connection->pack_message(len, timestamp, position_m_id, d_sender_id, msgbuf, vrpn_CONNECTION_LOW_LATENCY)) {
+	if (d_connection->pack_message(len, vrpn_Tracker::timestamp, position_m_id, d_sender_id, msgbuf, vrpn_CONNECTION_LOW_LATENCY)) {
 		std::cerr << " Can't write message";
 	}
+
+    if (derivatives != DERIV_NONE)
+        reportDerivatives(h.t);
+}
+
+void vrpn_Tracker_Camera::coordSetup(int _coord)
+{
+    coord = _coord;
+    coord_out = coord_converter(COORD_UE4, coord);
+}
+
+void vrpn_Tracker_Camera::delaySetup(double _delay)
+{
+    delay = _delay;
+}
+
+void vrpn_Tracker_Camera::derivativesSetup(int level)
+{
+    derivatives = level;
+    deriv_reset(&deriv);
+}
+
+/*
+    Velocity of reported pose: filtered UE4 pose history differentiated at
+    the same delayed time as position and converted to camera convention,
+    so clients can predict from VRPN report alone.
+*/
+void vrpn_Tracker_Camera::reportDerivatives(double t)
+{
+    q_vec_type out_vel, out_avel, p;
+    q_type q;
+    char msgbuf[1000];
+    vrpn_int32 len;
+
+    getOutputPose(coord, delay, t, p, q, out_vel, out_avel);
+    deriv_update(&deriv, t, out_vel, out_avel);
+
+    q_vec_copy(vel, deriv.vel);
+    deriv_quat(vel_quat, deriv.avel, DERIV_QUAT_DT);
+    vel_quat_dt = DERIV_QUAT_DT;
+    len = vrpn_Tracker::encode_vel_to(msgbuf);
+    if (d_connection->pack_message(len, vrpn_Tracker::timestamp, velocity_m_id, d_sender_id, msgbuf, vrpn_CONNECTION_LOW_LATENCY)) {
+        std::cerr << " Can't write message";
+    }
+
+    if (derivatives < DERIV_ACCELERATION)
+        return;
+
+    q_vec_copy(acc, deriv.acc);
+    deriv_quat(acc_quat, deriv.aacc, DERIV_QUAT_DT);
+    acc_quat_dt = DERIV_QUAT_DT;
+    len = vrpn_Tracker::encode_acc_to(msgbuf);
+    if (d_connection->pack_message(len, vrpn_Tracker::timestamp, accel_m_id, d_sender_id, msgbuf, vrpn_CONNECTION_LOW_LATENCY)) {
+        std::cerr << " Can't write message";
+    }
+}
+
+/*
+    Delay is specified as:
+
+        <ms>[ms]        - milliseconds
+        <n>f@<fps>      - video frames at given frame rate, e.g. 2f@50
+
+    returns seconds, negative on error
+*/
+double vrpn_Tracker_Camera::parseDelay(const char* str)
+{
+    char *end;
+    double v = strtod(str, &end), fps;
+
+    if (end == str || v < 0.0)
+        return -1.0;
+
+    if (!*end || !strcmp(end, "ms"))
+        return v / 1000.0;
+
+    if (end[0] == 'f' && end[1] == '@' && (fps = atof(end + 2)) > 0.0)
+        return v / fps;
+
+    return -1.0;
+}
+
+/*
+    Pose at time t interpolated between history samples around it, t out
+    of history range is clamped to oldest or newest sample.
+*/
+void vrpn_Tracker_Camera::delayedPose(double t, q_vec_type& pos, q_type& quat)
+{
+    unsigned int lo, hi, n = history_cnt < CAM_HISTORY_SLOTS ? history_cnt : CAM_HISTORY_SLOTS;
+    const cam_pose_t *a, *b;
+
+    if (!n)
+    {
+        q_vec_copy(pos, stage_pos);
+        q_copy(quat, stage_quat);
+        return;
+    }
+
+    lo = history_cnt - n;
+    hi = history_cnt - 1;
+    a = &history[lo % CAM_HISTORY_SLOTS];
+    b = &history[hi % CAM_HISTORY_SLOTS];
+
+    if (t >= b->t || n == 1)
+        a = b;
+    else if (t > a->t)
+    {
+        /* last sample not newer than t */
+        while (hi - lo > 1)
+        {
+            unsigned int mid = lo + (hi - lo) / 2;
+            if (history[mid % CAM_HISTORY_SLOTS].t <= t)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        a = &history[lo % CAM_HISTORY_SLOTS];
+        b = &history[hi % CAM_HISTORY_SLOTS];
+    }
+    else
+        b = a;
+
+    if (a == b || b->t <= a->t)
+    {
+        q_vec_copy(pos, a->pos);
+        q_copy(quat, a->quat);
+        return;
+    }
+
+    double k = (t - a->t) / (b->t - a->t);
+    for (int i = 0; i < 3; i++)
+        pos[i] = a->pos[i] + k * (b->pos[i] - a->pos[i]);
+    q_slerp(quat, a->quat, b->quat, k);
+}
+
+/*
+    Pose of <delay> before <now> in given coordinate convention with linear
+    and angular velocity estimated over CAM_VELOCITY_WINDOW of history.
+*/
+void vrpn_Tracker_Camera::getOutputPose(int c, double delay, double now, q_vec_type& pos, q_type& quat, q_vec_type& vel, q_vec_type& avel)
+{
+    int i;
+    q_vec_type prev_pos;
+    q_type prev_quat, i_prev_quat, dq, avel_q;
+    double s, angle, t = now - delay;
+
+    delayedPose(t, pos, quat);
+    delayedPose(t - CAM_VELOCITY_WINDOW, prev_pos, prev_quat);
+
+    for (i = 0; i < 3; i++)
+        vel[i] = (pos[i] - prev_pos[i]) / CAM_VELOCITY_WINDOW;
+
+    /* rotation over window as axis and angle */
+    q_invert(i_prev_quat, prev_quat);
+    q_mult(dq, quat, i_prev_quat);
+    if (dq[3] < 0.0)
+        for (i = 0; i < 4; i++)
+            dq[i] = -dq[i];
+    s = sqrt(dq[0] * dq[0] + dq[1] * dq[1] + dq[2] * dq[2]);
+    angle = 2.0 * atan2(s, dq[3]);
+    for (i = 0; i < 3; i++)
+        avel_q[i] = s > 1e-12 ? dq[i] / s * angle / CAM_VELOCITY_WINDOW : 0.0;
+    avel_q[3] = 0.0;
+
+    /* velocity converts as position, rotation axis as quaternion vector part */
+    coord_converter(COORD_UE4, c)(pos, quat, pos, quat);
+    coord_converter(COORD_UE4, c)(vel, avel_q, vel, avel_q);
+    q_vec_copy(avel, avel_q);
+}
+
+int vrpn_Tracker_Camera::getFusedCount()
+{
+    return fused_cnt;
+}
+
+long vrpn_Tracker_Camera::getFreedSent()
+{
+    return freed_sent;
+}
+
+long vrpn_Tracker_Camera::getFreedErrors()
+{
+    return freed_errors;
+}
+
+int vrpn_Tracker_Camera::getFreedTargetsCount()
+{
+    return (int)freed_targets.size();
 }
 
 void vrpn_Tracker_Camera::getRotation(q_type& q_current)
 {
-    q_current[0] = d_quat[0];
-    q_current[1] = d_quat[1];
-    q_current[2] = d_quat[2];
-    q_current[3] = d_quat[3];
+    q_current[0] = stage_quat[0];
+    q_current[1] = stage_quat[1];
+    q_current[2] = stage_quat[2];
+    q_current[3] = stage_quat[3];
+}
+
+// pose of last VRPN report: delayed and in camera convention
+void vrpn_Tracker_Camera::getReportedPose(q_vec_type& vec, q_type& quat)
+{
+    q_vec_copy(vec, pos);
+    q_copy(quat, d_quat);
 }
 
 void vrpn_Tracker_Camera::getPosition(q_vec_type& vec)
 {
-    vec[0] = pos[0];
-    vec[1] = pos[1];
-    vec[2] = pos[2];
+    vec[0] = stage_pos[0];
+    vec[1] = stage_pos[1];
+    vec[2] = stage_pos[2];
 }
 
-std::string vrpn_Tracker_Camera::getName()
+const std::string& vrpn_Tracker_Camera::getName()
 {
     return name;
 }
 
-std::string vrpn_Tracker_Camera::getTrackerSerial()
+const std::string& vrpn_Tracker_Camera::getTrackerSerial()
 {
     return tracker_serial;
 }
 
+int vrpn_Tracker_Camera::getIdx()
+{
+    return idx;
+}
+
+int vrpn_Tracker_Camera::getTrackersCount()
+{
+    return (int)trackers.size();
+}
+
+const std::string& vrpn_Tracker_Camera::getTrackerSerial(int t)
+{
+    return trackers[t].serial;
+}
+
+double vrpn_Tracker_Camera::getTrackerResidual(int t)
+{
+    return trackers[t].residual;
+}
+
+void vrpn_Tracker_Camera::trackerAdd(const std::string& serial, q_vec_type offset_pos, q_type offset_quat, int offset_auto)
+{
+    cam_tracker_t trk;
+
+    trk.serial = serial;
+    q_vec_copy(trk.offset_pos, offset_pos);
+    q_copy(trk.offset_quat, offset_quat);
+    trk.offset_auto = offset_auto;
+    trk.offset_known = !offset_auto;
+    trk.valid = 0;
+    trk.residual = 0.0;
+
+    trackers.push_back(trk);
+}
+
+/*
+    Store pose of tracker <t> at current tick and convert it to the
+    pose of primary tracker using known offset:
+
+        pos = tracker_pos + tracker_quat * offset_pos
+        quat = tracker_quat * offset_quat
+*/
+void vrpn_Tracker_Camera::trackerPose(int t, q_vec_type pos, q_type quat, int valid)
+{
+    cam_tracker_t& trk = trackers[t];
+
+    trk.valid = valid;
+    if (!valid)
+        return;
+
+    // learn offset from primary tracker, it is always processed first
+    if (t && trk.offset_auto && trackers[0].valid)
+    {
+        q_type i_quat, o_quat;
+        q_vec_type o_pos;
+
+        q_invert(i_quat, quat);
+        q_mult(o_quat, i_quat, trackers[0].quat);
+        q_vec_subtract(o_pos, trackers[0].pos, pos);
+        q_xform(o_pos, i_quat, o_pos);
+
+        if (!trk.offset_known)
+        {
+            q_vec_copy(trk.offset_pos, o_pos);
+            q_copy(trk.offset_quat, o_quat);
+            trk.offset_known = 1;
+        }
+        else
+        {
+            // slow refinement keeps switching between trackers smooth
+            int i;
+            double dot = 0.0;
+            for (i = 0; i < 4; i++)
+                dot += o_quat[i] * trk.offset_quat[i];
+            for (i = 0; i < 4; i++)
+                trk.offset_quat[i] = 0.99 * trk.offset_quat[i] + 0.01 * (dot < 0.0 ? -o_quat[i] : o_quat[i]);
+            q_normalize(trk.offset_quat, trk.offset_quat);
+            for (i = 0; i < 3; i++)
+                trk.offset_pos[i] = 0.99 * trk.offset_pos[i] + 0.01 * o_pos[i];
+        }
+    }
+
+    if (!trk.offset_known)
+    {
+        trk.valid = 0;
+        return;
+    }
+
+    q_vec_type arm_vec;
+    q_xform(arm_vec, quat, trk.offset_pos);
+    q_vec_add(trk.pos, pos, arm_vec);
+    q_mult(trk.quat, quat, trk.offset_quat);
+}
+
+/*
+    Fuse primary tracker pose estimates from all tracking trackers,
+    weighted by recent residual to fused pose. If no tracker is tracking,
+    last fused pose is returned. Returns number of fused trackers.
+*/
+#define TRACKER_RESIDUAL_SCALE 0.002
+
+int vrpn_Tracker_Camera::trackerFuse(q_vec_type& pos, q_type& quat)
+{
+    int i, used = 0;
+    double w_sum = 0.0;
+    q_vec_type p = { 0.0, 0.0, 0.0 };
+    q_type q = { 0.0, 0.0, 0.0, 0.0 };
+    const double *q_ref = NULL;
+
+    for (auto& trk : trackers)
+    {
+        double w, dot = 0.0;
+
+        if (!trk.valid)
+            continue;
+
+        w = 1.0 / (1.0 + trk.residual / TRACKER_RESIDUAL_SCALE);
+
+        // align quaternions to same hemisphere before averaging
+        if (!q_ref)
+            q_ref = trk.quat;
+        for (i = 0; i < 4; i++)
+            dot += trk.quat[i] * q_ref[i];
+
+        for (i = 0; i < 3; i++)
+            p[i] += w * trk.pos[i];
+        for (i = 0; i < 4; i++)
+            q[i] += w * (dot < 0.0 ? -trk.quat[i] : trk.quat[i]);
+
+        w_sum += w;
+        used++;
+    }
+
+    if (used)
+    {
+        for (i = 0; i < 3; i++)
+            fused_pos[i] = p[i] / w_sum;
+        q_normalize(fused_quat, q);
+        fused = 1;
+        fused_cnt = used;
+
+        // update residuals of trackers used
+        for (auto& trk : trackers)
+            if (trk.valid)
+                trk.residual = 0.9 * trk.residual + 0.1 * q_vec_distance(trk.pos, fused_pos);
+    }
+
+    else
+        fused_cnt = 0;
+
+    if (!fused)
+        return 0;
+
+    q_vec_copy(pos, fused_pos);
+    q_copy(quat, fused_quat);
+
+    return used;
+}
+
+void vrpn_Tracker_Camera::dropoutSetup(int policy, double max_time, double blend_time)
+{
+    dropout_policy = policy;
+    dropout_max = max_time;
+    dropout_blend = blend_time;
+}
+
+int vrpn_Tracker_Camera::getTrackingState()
+{
+    return tracking_state;
+}
+
+const char* vrpn_Tracker_Camera::getTrackingStateName(int state)
+{
+    return
+        CAM_TRACKING_OK == state ? "OK" :
+        CAM_TRACKING_HOLD == state ? "HOLD" :
+        CAM_TRACKING_EXTRAPOLATE == state ? "EXTRAPOLATE" :
+        CAM_TRACKING_LOST == state ? "LOST" :
+        CAM_TRACKING_BLEND == state ? "BLEND" :
+        "Unknown";
+}
+
+/*
+    Replace fused pose of camera trackers when none of them is tracking:
+    hold last live pose or extrapolate it from recent velocity for at most
+    dropout_max seconds (0 - forever), then freeze it. On reacquisition
+    offset between output and live pose decays to zero over dropout_blend
+    seconds. Poses are in OpenVR space, before filters.
+*/
+void vrpn_Tracker_Camera::dropoutProcess(q_vec_type& tracker_pos, q_type& tracker_quat, int valid, struct timeval *tv)
+{
+    int i;
+    double now = tv->tv_sec + tv->tv_usec / 1000000.0;
+
+    if (valid)
+    {
+        double dt = now - live_time;
+
+        // estimate velocities from consecutive live samples
+        if (live_cnt && tracking_state == CAM_TRACKING_OK && dt > 0.0 && dt < 0.1)
+        {
+            q_type i_quat, dq;
+            double ax, ay, az, angle;
+
+            q_invert(i_quat, live_quat);
+            q_mult(dq, tracker_quat, i_quat);
+            if (dq[Q_W] < 0.0)
+                for (i = 0; i < 4; i++)
+                    dq[i] = -dq[i];
+            q_to_axis_angle(&ax, &ay, &az, &angle, dq);
+
+            for (i = 0; i < 3; i++)
+                live_vel[i] = 0.8 * live_vel[i] + 0.2 * (tracker_pos[i] - live_pos[i]) / dt;
+            live_avel[0] = 0.8 * live_avel[0] + 0.2 * ax * angle / dt;
+            live_avel[1] = 0.8 * live_avel[1] + 0.2 * ay * angle / dt;
+            live_avel[2] = 0.8 * live_avel[2] + 0.2 * az * angle / dt;
+        }
+        else if (!live_cnt)
+        {
+            live_vel[0] = live_vel[1] = live_vel[2] = 0.0;
+            live_avel[0] = live_avel[1] = live_avel[2] = 0.0;
+        }
+
+        q_vec_copy(live_pos, tracker_pos);
+        q_copy(live_quat, tracker_quat);
+        live_time = now;
+        live_cnt++;
+
+        // reacquired after dropout
+        if (tracking_state != CAM_TRACKING_OK && tracking_state != CAM_TRACKING_BLEND)
+        {
+            if (dropout_blend > 0.0)
+            {
+                q_type i_quat;
+
+                q_vec_subtract(blend_pos, out_pos, tracker_pos);
+                q_invert(i_quat, tracker_quat);
+                q_mult(blend_quat, out_quat, i_quat);
+                blend_time = now;
+                tracking_state = CAM_TRACKING_BLEND;
+            }
+            else
+                tracking_state = CAM_TRACKING_OK;
+        }
+
+        // blend back to live pose
+        if (tracking_state == CAM_TRACKING_BLEND)
+        {
+            double a = (now - blend_time) / dropout_blend;
+
+            if (a >= 1.0)
+                tracking_state = CAM_TRACKING_OK;
+            else
+            {
+                q_vec_type d_pos;
+                q_type dq, ident = { 0.0, 0.0, 0.0, 1.0 };
+
+                q_vec_scale(d_pos, 1.0 - a, blend_pos);
+                q_vec_add(tracker_pos, tracker_pos, d_pos);
+                q_slerp(dq, blend_quat, ident, a);
+                q_mult(tracker_quat, dq, tracker_quat);
+            }
+        }
+    }
+    else if (live_cnt)
+    {
+        double elapsed, angle;
+
+        // dropout begins
+        if (tracking_state == CAM_TRACKING_OK || tracking_state == CAM_TRACKING_BLEND)
+        {
+            dropout_time = now;
+            tracking_state = (dropout_policy == CAM_DROPOUT_EXTRAPOLATE) ? CAM_TRACKING_EXTRAPOLATE : CAM_TRACKING_HOLD;
+
+            // continue from what was sent last
+            q_vec_copy(live_pos, out_pos);
+            q_copy(live_quat, out_quat);
+            live_time = now;
+        }
+
+        elapsed = now - dropout_time;
+        if (dropout_max > 0.0 && elapsed > dropout_max)
+        {
+            elapsed = dropout_max;
+            tracking_state = CAM_TRACKING_LOST;
+        }
+
+        if (dropout_policy == CAM_DROPOUT_EXTRAPOLATE)
+        {
+            q_type dq;
+
+            for (i = 0; i < 3; i++)
+                tracker_pos[i] = live_pos[i] + live_vel[i] * elapsed;
+
+            angle = q_vec_magnitude(live_avel) * elapsed;
+            q_from_axis_angle(dq, live_avel[0], live_avel[1], live_avel[2], angle);
+            q_mult(tracker_quat, dq, live_quat);
+        }
+        else
+        {
+            q_vec_copy(tracker_pos, live_pos);
+            q_copy(tracker_quat, live_quat);
+        }
+    }
+
+    q_vec_copy(out_pos, tracker_pos);
+    q_copy(out_quat, tracker_quat);
+}
+
 void vrpn_Tracker_Camera::mainloop() {
 //    vrpn_gettimeofday( &(vrpn_Tracker_Camera::timestamp), NULL );
 	vrpn_Tracker::server_mainloop();
     freedSend();
+
+    vrpn_Analog::channel[0] = tracking_state;
+    vrpn_Analog::channel[1] = fused_cnt;
+    vrpn_Analog::timestamp = vrpn_Tracker::timestamp;
+    vrpn_Analog::report_changes();
 }
 
+/*
+    FreeD target is specified as:
+
+        <host>:<port>[,<option>=<value>...]
+
+    options:
+
+        rate=<hz>   - send not faster then <hz> packets per second
+        div=<n>     - send every <n>-th tick
+        seq=1       - put sequence counter into Spare field
+        state=1     - put camera tracking state into Spare field
+        coord=<c>   - coordinate convention (see coord.h), default is camera's
+        delay=<d>   - send pose of <d> ago, milliseconds or frames (see parseDelay)
+        pace=<ms>   - transmit packet <ms> after its slot (tick time, or rate grid
+                      time with rate=), so packets leave evenly spaced
+        txtime=<m>  - with pace=, stamp packets with transmit time by SO_TXTIME
+                      for etf or fq qdisc, userspace pacing if not supported or
+                      no such qdisc is found on egress interface
+*/
 void vrpn_Tracker_Camera::freedAdd(char *host_port)
 {
-    char *port, *host = strdup(host_port);
+    char *port, *opts, *host = strdup(host_port);
+
+    opts = strchr(host, ',');
+    if (opts)
+    {
+        *opts = 0; opts++;
+    }
 
     port = strrchr(host, ':');
     if (port)
     {
-        struct sockaddr_in addr;
+        freed_target_t trg;
 
         *port = 0; port++;
 
-        /* prepare address */
-        addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = inet_addr(host);
-        addr.sin_port = htons((unsigned short)atoi(port));
+        memset(&trg, 0, sizeof(trg));
+        trg.divisor = 1;
+        trg.coord = -1;
+        trg.txtime_socket = -1;
 
-        /* store address */
-        freed_sockaddr.push_back(addr);
+        /* prepare address */
+        trg.addr.sin_family = AF_INET;
+        trg.addr.sin_addr.s_addr = inet_addr(host);
+        trg.addr.sin_port = htons((unsigned short)atoi(port));
+
+        /* parse options */
+        while (opts && *opts)
+        {
+            char *val, *next = strchr(opts, ',');
+
+            if (next)
+            {
+                *next = 0; next++;
+            }
+
+            val = strchr(opts, '=');
+            if (val)
+            {
+                *val = 0; val++;
+
+                if (!strcmp(opts, "rate") && atof(val) > 0.0)
+                    trg.period = 1.0 / atof(val);
+                else if (!strcmp(opts, "div") && atoi(val) > 0)
+                    trg.divisor = atoi(val);
+                else if (!strcmp(opts, "seq"))
+                    trg.seq = atoi(val);
+                else if (!strcmp(opts, "state"))
+                    trg.state = atoi(val);
+                else if (!strcmp(opts, "coord") && coord_find(val) >= 0)
+                    trg.coord = coord_find(val);
+                else if (!strcmp(opts, "delay") && parseDelay(val) >= 0.0)
+                    trg.delay = parseDelay(val);
+                else if (!strcmp(opts, "pace") && atof(val) >= 0.0)
+                    trg.pace = atof(val) / 1000.0;
+                else if (!strcmp(opts, "txtime") && packet_pacer::txtimeFind(val) >= 0)
+                    trg.txtime = packet_pacer::txtimeFind(val);
+                else
+                    std::cerr << "Unknown FreeD target option [" << opts << "=" << val << "]" << std::endl;
+            }
+
+            opts = next;
+        }
+
+        /* kernel pacing needs its own socket, every datagram carries transmit time */
+        if (trg.pace > 0.0 && trg.txtime != PACER_TXTIME_NONE)
+        {
+            trg.txtime_socket = packet_pacer::txtimeOpen(trg.txtime, &trg.addr);
+            if (trg.txtime_socket < 0)
+                std::cerr << "SO_TXTIME is not supported or no " << (trg.txtime == PACER_TXTIME_ETF ? "etf" : "fq") << " qdisc on egress interface, FreeD target [" << host << ":" << port << "] is paced in userspace" << std::endl;
+        }
+
+        /* store target */
+        freed_targets.push_back(trg);
     }
 
     free(host);
 }
 
+/* some target needs userspace pacer */
+bool vrpn_Tracker_Camera::freedPaced()
+{
+    for (const auto& trg : freed_targets)
+        if (trg.pace > 0.0 && trg.txtime_socket < 0)
+            return true;
+
+    return false;
+}
+
+void vrpn_Tracker_Camera::pacerSetup(packet_pacer* _pacer)
+{
+    pacer = _pacer;
+}
+
+void vrpn_Tracker_Camera::freedTransmit(freed_target_t& trg, unsigned char* buf, int len, double slot)
+{
+    int r;
+
+    if (trg.pace > 0.0 && trg.txtime_socket >= 0)
+    {
+        /* datagrams qdisc dropped for missed transmit time come back by error queue */
+        freed_errors += packet_pacer::txtimeDropped(trg.txtime_socket);
+        r = packet_pacer::txtimeSend(trg.txtime_socket, trg.txtime, &trg.addr, buf, len, slot + trg.pace);
+    }
+    else if (trg.pace > 0.0 && pacer)
+        r = pacer->send(freed_socket, &trg.addr, buf, len, slot + trg.pace) ? len : -1;
+    else
+        r = sendto
+        (
+            freed_socket,                   /* Socket to send result */
+            (char*)buf,                     /* The datagram buffer */
+            len,                            /* The datagram lngth */
+            0,                              /* Flags: no options */
+            (struct sockaddr *)&trg.addr,   /* addr */
+            sizeof(struct sockaddr_in)      /* Server address length */
+        );
+
+    if (r < 0)
+        freed_errors++;
+    else
+        freed_sent++;
+}
+
 void vrpn_Tracker_Camera::freedSend()
 {
+    int packed = -1;
+    double now, packed_delay = 0.0;
     FreeD_D1_t freed;
     unsigned char buf[FREE_D_D1_PACKET_SIZE];
 
@@ -211,37 +877,83 @@ void vrpn_Tracker_Camera::freedSend()
     if (freed_socket <= 0)
         return;
 
-    memset(&freed, 0, sizeof(freed));
-
-    freed.ID = idx + 1;
-
-    q_vec_type pos;
-    getPosition(pos);
-    freed.X = pos[0] * 1000.0;
-    freed.Y = pos[1] * 1000.0;
-    freed.Z = pos[2] * 1000.0;
+    /* tick time */
+    now = vrpn_Tracker::timestamp.tv_sec + vrpn_Tracker::timestamp.tv_usec / 1000000.0;
 
-    q_type quat;
-    getRotation(quat);
-    q_vec_type yawPitchRoll;
-    q_to_euler(yawPitchRoll, quat);
-    freed.Pan = yawPitchRoll[0] * 180.0 / 3.1415926;
-    freed.Roll = yawPitchRoll[2] * 180.0 / 3.1415926;
-    freed.Tilt = yawPitchRoll[1] * 180.0 / 3.1415926;
-
-    FreeD_D1_pack(buf, FREE_D_D1_PACKET_SIZE, &freed);
-
-    for (const struct sockaddr_in /*auto&*/ addr : freed_sockaddr)
+    for (auto& trg : freed_targets)
     {
-        sendto
-        (
-            freed_socket,               /* Socket to send result */
-            (char*)buf,                 /* The datagram buffer */
-            sizeof(buf),                /* The datagram lngth */
-            0,                          /* Flags: no options */
-            (struct sockaddr *)&addr,   /* addr */
-            sizeof(struct sockaddr_in)  /* Server address length */
-        );
+        /* decimate by ticks count */
+        if ((trg.ticks++ % trg.divisor) != 0)
+            continue;
+
+        /* decimate by rate, slot is time packet is scheduled for */
+        double slot = now;
+        if (trg.period > 0.0)
+        {
+            if (now < trg.next)
+                continue;
+
+            /* keep average rate, but do not try to catch up after stalls */
+            slot = trg.next;
+            trg.next += trg.period;
+            if (trg.next < now)
+            {
+                slot = now;
+                trg.next = now + trg.period;
+            }
+        }
+
+        /* pack latest pose only once per tick, coordinate convention and delay */
+        int c = trg.coord < 0 ? coord : trg.coord;
+        if (packed != c || packed_delay != trg.delay)
+        {
+            memset(&freed, 0, sizeof(freed));
+
+            freed.ID = idx + 1;
+
+            q_vec_type pos;
+            q_type quat, quat_c;
+            if (trg.delay > 0.0)
+                delayedPose(now - trg.delay, pos, quat);
+            else
+            {
+                q_vec_copy(pos, stage_pos);
+                q_copy(quat, stage_quat);
+            }
+
+            /* Pan/Tilt/Roll are angles about Z-up axes, q_to_euler gives them
+               from UE4 rotation only, convention applies to position */
+            q_vec_type yawPitchRoll;
+            q_to_euler(yawPitchRoll, quat);
+            coord_converter(COORD_UE4, c)(pos, quat, pos, quat_c);
+
+            /* FreeD carries millimeters whatever units of convention are */
+            freed.X = pos[0] * 1000.0 / coord_conventions[c].scale;
+            freed.Y = pos[1] * 1000.0 / coord_conventions[c].scale;
+            freed.Z = pos[2] * 1000.0 / coord_conventions[c].scale;
+
+            freed.Pan = yawPitchRoll[0] * 180.0 / 3.1415926;
+            freed.Roll = yawPitchRoll[2] * 180.0 / 3.1415926;
+            freed.Tilt = yawPitchRoll[1] * 180.0 / 3.1415926;
+
+            FreeD_D1_pack(buf, FREE_D_D1_PACKET_SIZE, &freed);
+
+            packed = c;
+            packed_delay = trg.delay;
+        }
+
+        /* Spare field differs per target, repack if needed */
+        int spare = 0;
+        if (trg.seq)
+            spare |= FREE_D_SPARE_SEQ_FLAG | (trg.seq_cnt++ & FREE_D_SPARE_SEQ_MASK);
+        if (trg.state)
+            spare |= (tracking_state << FREE_D_SPARE_STATE_SHIFT) & FREE_D_SPARE_STATE_MASK;
+        if (FREE_D_SPARE_GET(&freed) != spare)
+        {
+            FREE_D_SPARE_SET(&freed, spare);
+            FreeD_D1_pack(buf, FREE_D_D1_PACKET_SIZE, &freed);
+        }
+
+        freedTransmit(trg, buf, sizeof(buf), slot);
     }
 }
-
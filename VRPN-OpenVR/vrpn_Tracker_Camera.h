@@ -2,14 +2,82 @@
 
 #include <list>
 #include <string>
+#include <vector>
+#if !defined(_WIN32)
+#include <netinet/in.h>
+#endif
 #include <vrpn_Tracker.h>
+#include <vrpn_Analog.h>
 //#include "vrpn_Tracker_OpenVR.h"
 #include <quat.h>
 
 #include "filter.h"
+#include "coord.h"
+#include "pacer.h"
+#include "derivatives.h"
+
+/// Camera tracking state, exported over VRPN analog channel 0 and FreeD Spare field
+enum cam_tracking_state
+{
+    CAM_TRACKING_OK = 0,            // live pose
+    CAM_TRACKING_HOLD = 1,          // trackers lost, holding last pose
+    CAM_TRACKING_EXTRAPOLATE = 2,   // trackers lost, extrapolating from recent velocity
+    CAM_TRACKING_LOST = 3,          // dropout exceeded max time, pose is frozen
+    CAM_TRACKING_BLEND = 4          // trackers reacquired, blending back to live pose
+};
+
+/* pose history for output delay, power of 2, about 2 seconds at 1000 Hz */
+#define CAM_HISTORY_SLOTS 2048
+
+/* time span of history velocities are estimated over, seconds */
+#define CAM_VELOCITY_WINDOW 0.01
+
+enum cam_dropout_policy
+{
+    CAM_DROPOUT_HOLD = 0,
+    CAM_DROPOUT_EXTRAPOLATE = 1
+};
+
+typedef struct
+{
+    struct sockaddr_in addr;
+    int divisor;            // send every N-th tick, 1 - every tick
+    double period;          // seconds between packets, 0 - not rate limited
+    double next;            // time when next packet is due
+    unsigned int ticks;
+    int seq;                // write sequence counter into Spare field
+    int state;              // write camera tracking state into Spare field
+    int coord;              // coordinate convention, -1 - same as camera
+    double delay;           // seconds, send pose of that time ago
+    double pace;            // seconds, transmit at slot time + pace, 0 - send immediately
+    int txtime;             // PACER_TXTIME_*, kernel holds datagram until transmit time
+    int txtime_socket;      // SO_TXTIME socket of target, -1 - userspace pacing
+    unsigned int seq_cnt;
+} freed_target_t;
+
+typedef struct
+{
+    double t;
+    q_vec_type pos;
+    q_type quat;
+} cam_pose_t;
+
+typedef struct
+{
+    std::string serial;
+    q_vec_type offset_pos;  // primary tracker position in this tracker frame
+    q_type offset_quat;     // primary tracker rotation relative to this tracker
+    int offset_auto;        // learn offset while primary tracker is tracking
+    int offset_known;
+    int valid;              // tracker is tracking at current tick
+    q_vec_type pos;         // primary tracker pose estimated from this tracker
+    q_type quat;
+    double residual;        // recent distance to fused pose, meters
+} cam_tracker_t;
 
 class vrpn_Tracker_Camera :
-    public vrpn_Tracker
+    public vrpn_Tracker,
+    public vrpn_Analog
 {
 public:
     vrpn_Tracker_Camera(int idx, const std::string& name, vrpn_Connection* connection, const std::string& tracker_serial, q_vec_type arm);
@@ -17,20 +85,71 @@ public:
     void updateTracking(q_vec_type tracker_pos, q_type tracker_quat, q_vec_type reference_pos, q_type reference_quat, q_vec_type reference_point, struct timeval *tv);
     void getRotation(q_type& quat);
     void getPosition(q_vec_type& vec);
-    std::string getName();
-    std::string getTrackerSerial();
+    void getReportedPose(q_vec_type& vec, q_type& quat);
+    const std::string& getName();
+    const std::string& getTrackerSerial();
+    const std::string& getTrackerSerial(int t);
+    int getTrackersCount();
+    int getFusedCount();
+    long getFreedSent();
+    long getFreedErrors();
+    int getFreedTargetsCount();
+    void getOutputPose(int coord, double delay, double now, q_vec_type& pos, q_type& quat, q_vec_type& vel, q_vec_type& avel);
+    void trackerAdd(const std::string& serial, q_vec_type offset_pos, q_type offset_quat, int offset_auto);
+    void trackerPose(int t, q_vec_type pos, q_type quat, int valid);
+    int trackerFuse(q_vec_type& pos, q_type& quat);
+    double getTrackerResidual(int t);
+    void dropoutSetup(int policy, double max_time, double blend_time);
+    void dropoutProcess(q_vec_type& tracker_pos, q_type& tracker_quat, int valid, struct timeval *tv);
+    int getTrackingState();
+    static const char* getTrackingStateName(int state);
+    int getIdx();
     void freedAdd(char *host_port);
+    bool freedPaced();
+    void pacerSetup(packet_pacer* pacer);
     void filterAdd(filter_abstract* flt);
+    long getFilterRejected();
+    void coordSetup(int coord);
+    void delaySetup(double delay);
+    void derivativesSetup(int level);
+    static double parseDelay(const char* str);
 protected:
     void freedSend();
+    void freedTransmit(freed_target_t& trg, unsigned char* buf, int len, double slot);
+    void delayedPose(double t, q_vec_type& pos, q_type& quat);
+    void reportDerivatives(double t);
 
 private:
     q_vec_type arm;
+    q_vec_type stage_pos;   // camera pose in UE4 space, VRPN report is converted from it
+    q_type stage_quat;
+    int coord;              // coordinate convention of VRPN report
+    coord_pose_fn coord_out;
+    double delay;           // seconds, VRPN report is pose of that time ago
+    cam_pose_t history[CAM_HISTORY_SLOTS];
+    int derivatives;        // DERIV_*, of filtered pose in convention of VRPN report
+    deriv_state_t deriv;
+    unsigned int history_cnt;
     std::string name;
     std::string tracker_serial;
-    std::list<std::string> freed_targets;
-    std::list<struct sockaddr_in> freed_sockaddr;
+    std::vector<cam_tracker_t> trackers;
+    q_vec_type fused_pos;
+    q_type fused_quat;
+    int fused, fused_cnt;
+
+    int dropout_policy;
+    double dropout_max, dropout_blend;  // seconds
+    int tracking_state;
+    int live_cnt;
+    double live_time, dropout_time, blend_time;
+    q_vec_type live_pos, live_vel, live_avel;   // last live pose, linear and angular velocity
+    q_type live_quat;
+    q_vec_type out_pos, blend_pos;              // last output pose, offset at reacquisition
+    q_type out_quat, blend_quat;
+    std::list<freed_target_t> freed_targets;
     int freed_socket;
+    long freed_sent, freed_errors;      // datagrams sent and failed, all targets
+    packet_pacer* pacer;                // shared userspace pacer of paced targets
     int idx;
 
     filter_abstract* filters_list[16];
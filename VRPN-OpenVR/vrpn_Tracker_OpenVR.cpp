@@ -2,6 +2,7 @@
 #include <openvr.h>
 #include <quat.h>
 #include <iostream>
+#include <math.h>
 
 // -------------------------------------------------------------------------------------
 //
@@ -38,12 +39,39 @@ static vr::HmdVector3_t GetPosition(vr::HmdMatrix34_t matrix) {
 // -------------------------------------------------------------------------------------
 
 vrpn_Tracker_OpenVR::vrpn_Tracker_OpenVR(const std::string& name, vrpn_Connection* connection, vr::IVRSystem * vr, vr::TrackedDeviceIndex_t trackedDeviceIndex) :
-	vrpn_Tracker(name.c_str(), connection), name(name), vr(vr), trackedDeviceIndex(trackedDeviceIndex)
+	vrpn_Tracker(name.c_str(), connection), vr(vr), trackedDeviceIndex(trackedDeviceIndex), name(name)
 {
 	// Initialize the vrpn_Tracker
     // We track each device separately so this will only ever have one sensor
 	vrpn_Tracker::num_sensors = 1;
     device_class_id = vr->GetTrackedDeviceClass(trackedDeviceIndex);
+    tracking_result = vr::TrackingResult_Uninitialized;
+    pose_valid = false;
+    report_policy = { 0.0, 0.0, 0.0, 0.0 };
+    reported = false;
+    derivatives = DERIV_NONE;
+    deriv_reset(&deriv);
+}
+
+// device without OpenVR behind it, pose is fed by subclass
+vrpn_Tracker_OpenVR::vrpn_Tracker_OpenVR(const std::string& name, vrpn_Connection* connection, vr::ETrackedDeviceClass device_class_id) :
+	vrpn_Tracker(name.c_str(), connection), vr(nullptr), trackedDeviceIndex(vr::k_unTrackedDeviceIndexInvalid), name(name)
+{
+	vrpn_Tracker::num_sensors = 1;
+    this->device_class_id = device_class_id;
+    tracking_result = vr::TrackingResult_Uninitialized;
+    pose_valid = false;
+    report_policy = { 0.0, 0.0, 0.0, 0.0 };
+    reported = false;
+    derivatives = DERIV_NONE;
+    deriv_reset(&deriv);
+}
+
+// rebind device to runtime after OpenVR restart, index may differ, nullptr while runtime is gone
+void vrpn_Tracker_OpenVR::attach(vr::IVRSystem * vr, vr::TrackedDeviceIndex_t trackedDeviceIndex)
+{
+    this->vr = vr;
+    this->trackedDeviceIndex = trackedDeviceIndex;
 }
 
 void vrpn_Tracker_OpenVR::updateTracking(vr::TrackedDevicePose_t *pose)
@@ -74,8 +102,8 @@ void vrpn_Tracker_OpenVR::updateTracking(vr::TrackedDevicePose_t *pose)
     // prerotate HTC Vive Tracker
     if (device_class_id == vr::TrackedDeviceClass_GenericTracker)
     {
-        q_type prerot90;
-        q_from_euler(prerot90, 0, 0, -3.1415926 / 2.0); // double yaw, double pitch, double roll
+        // q_from_euler(prerot90, 0, 0, -M_PI / 2.0): roll -90 degrees about X
+        static const q_type prerot90 = { -0.70710678118654752, 0.0, 0.0, 0.70710678118654752 };
         q_mult(q_current, q_current, prerot90);
     };
 
@@ -87,11 +115,125 @@ void vrpn_Tracker_OpenVR::updateTracking(vr::TrackedDevicePose_t *pose)
 
     // Pack message
 	vrpn_gettimeofday(&timestamp, NULL);
+
+    // OpenVR velocities are in tracking space as position, prerotation does not change them;
+    // pose without tracking (e.g. rotation only fallback) has no usable velocity
+    if (derivatives != DERIV_NONE && !isTracking())
+        deriv_reset(&deriv);
+    else if (derivatives != DERIV_NONE)
+    {
+        q_vec_type v, w;
+        for (int i = 0; i < 3; i++)
+        {
+            v[i] = pose->vVelocity.v[i];
+            w[i] = pose->vAngularVelocity.v[i];
+        }
+        deriv_update(&deriv, timestamp.tv_sec + timestamp.tv_usec / 1000000.0, v, w);
+    }
+
+	reportPose();
+}
+
+void vrpn_Tracker_OpenVR::setDerivatives(int level)
+{
+    derivatives = level;
+}
+
+// pack velocity and acceleration messages, sent together with position report;
+// held pose (keep-alive repeat, not tracking) is reported as not moving
+void vrpn_Tracker_OpenVR::reportDerivatives(bool hold)
+{
+	char msgbuf[1000];
+	vrpn_int32 len;
+    static const q_vec_type zero = { 0.0, 0.0, 0.0 };
+
+    q_vec_copy(vel, hold ? zero : deriv.vel);
+    deriv_quat(vel_quat, hold ? zero : deriv.avel, DERIV_QUAT_DT);
+    vel_quat_dt = DERIV_QUAT_DT;
+	len = vrpn_Tracker::encode_vel_to(msgbuf);
+	if (d_connection->pack_message(len, timestamp, velocity_m_id, d_sender_id, msgbuf, vrpn_CONNECTION_LOW_LATENCY)) {
+		std::cerr << " Can't write message";
+	}
+
+    if (derivatives < DERIV_ACCELERATION)
+        return;
+
+    q_vec_copy(acc, hold ? zero : deriv.acc);
+    deriv_quat(acc_quat, hold ? zero : deriv.aacc, DERIV_QUAT_DT);
+    acc_quat_dt = DERIV_QUAT_DT;
+	len = vrpn_Tracker::encode_acc_to(msgbuf);
+	if (d_connection->pack_message(len, timestamp, accel_m_id, d_sender_id, msgbuf, vrpn_CONNECTION_LOW_LATENCY)) {
+		std::cerr << " Can't write message";
+	}
+}
+
+// pack position message of current pose and timestamp if reporting policy allows,
+// repeat - keep-alive of last reported pose
+void vrpn_Tracker_OpenVR::reportPose(bool repeat)
+{
+	if (!reportDue())
+		return;
 	char msgbuf[1000];
 	vrpn_int32 len = vrpn_Tracker::encode_to(msgbuf);
 	if (d_connection->pack_message(len, timestamp, position_m_id, d_sender_id, msgbuf, vrpn_CONNECTION_LOW_LATENCY)) {
 		std::cerr << " Can't write message";
 	}
+	bool hold = repeat || !isTracking();
+	if (derivatives != DERIV_NONE && (hold || deriv.samples))
+		reportDerivatives(hold);
+}
+
+void vrpn_Tracker_OpenVR::setReportPolicy(const report_policy_t& policy)
+{
+    report_policy = policy;
+}
+
+// repeat last reported pose when keep-alive is due, for ticks without new pose
+void vrpn_Tracker_OpenVR::reportKeepalive(const struct timeval *now)
+{
+    double dt;
+
+    if (!reported || report_policy.keepalive <= 0.0)
+        return;
+
+    dt = (now->tv_sec - report_tv.tv_sec) + (now->tv_usec - report_tv.tv_usec) / 1000000.0;
+    if (dt < report_policy.keepalive)
+        return;
+
+    timestamp = *now;
+    reportPose(true);
+}
+
+// check current pose against reporting policy, remember it if it is sent
+bool vrpn_Tracker_OpenVR::reportDue()
+{
+    if (reported)
+    {
+        double dt = (timestamp.tv_sec - report_tv.tv_sec) + (timestamp.tv_usec - report_tv.tv_usec) / 1000000.0;
+
+        if (dt < report_policy.min_interval)
+            return false;
+
+        if (report_policy.deadband_pos > 0.0 || report_policy.deadband_rot > 0.0)
+        {
+            double dot = fabs(report_quat[0] * d_quat[0] + report_quat[1] * d_quat[1] + report_quat[2] * d_quat[2] + report_quat[3] * d_quat[3]);
+            double angle = 2.0 * acos(dot > 1.0 ? 1.0 : dot);
+
+            bool moved =
+                (report_policy.deadband_pos > 0.0 && q_vec_distance(report_pos, pos) > report_policy.deadband_pos) ||
+                (report_policy.deadband_rot > 0.0 && angle > report_policy.deadband_rot);
+
+            if (!moved && (report_policy.keepalive <= 0.0 || dt < report_policy.keepalive))
+                return false;
+        }
+    }
+
+    q_vec_copy(report_pos, pos);
+    q_copy(report_quat, d_quat);
+    report_tv = timestamp;
+    reported = true;
+
+    return true;
 }
 
 void vrpn_Tracker_OpenVR::getRotation(q_type& q_current)
@@ -109,11 +251,46 @@ void vrpn_Tracker_OpenVR::getPosition(q_vec_type& vec)
     vec[2] = pos[2];
 }
 
-std::string vrpn_Tracker_OpenVR::getName()
+const std::string& vrpn_Tracker_OpenVR::getName()
 {
     return name;
 }
 
+const std::string& vrpn_Tracker_OpenVR::getSerial()
+{
+    return serial;
+}
+
+void vrpn_Tracker_OpenVR::setSerial(const std::string& serial)
+{
+    this->serial = serial;
+}
+
+vr::ETrackedDeviceClass vrpn_Tracker_OpenVR::getDeviceClass()
+{
+    return device_class_id;
+}
+
+void vrpn_Tracker_OpenVR::setTrackingState(vr::ETrackingResult result, bool valid)
+{
+    tracking_result = result;
+    pose_valid = valid;
+
+    /* acceleration is not computed across tracking gap */
+    if (!isTracking())
+        deriv_reset(&deriv);
+}
+
+vr::ETrackingResult vrpn_Tracker_OpenVR::getTrackingResult()
+{
+    return tracking_result;
+}
+
+bool vrpn_Tracker_OpenVR::isTracking()
+{
+    return pose_valid && tracking_result == vr::TrackingResult_Running_OK;
+}
+
 void vrpn_Tracker_OpenVR::mainloop() {
     vrpn_gettimeofday( &(vrpn_Tracker_OpenVR::timestamp), NULL );
 	vrpn_Tracker::server_mainloop();
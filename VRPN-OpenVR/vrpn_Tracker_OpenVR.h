@@ -4,6 +4,23 @@
 #include <openvr.h>
 #include <vrpn_Tracker.h>
 #include <quat.h>
+#include "derivatives.h"
+
+/*
+    Reporting policy of VRPN position messages: a pose is sent when it moved
+    more than dead-band or when keep-alive interval expired, but not more
+    often than min_interval. Zero dead-band of one component (position or
+    rotation) ignores it, both zero sends every sample. Keep-alive repeats
+    last pose while device is not tracking too; repeats and poses without
+    tracking carry zero velocity and acceleration.
+*/
+typedef struct
+{
+    double deadband_pos;    // meters
+    double deadband_rot;    // radians
+    double keepalive;       // seconds, 0 - no keep-alive
+    double min_interval;    // seconds, 0 - no rate limit
+} report_policy_t;
 
 class vrpn_Tracker_OpenVR :
 	public vrpn_Tracker
@@ -14,14 +31,39 @@ public:
 	void updateTracking(vr::TrackedDevicePose_t *pose);
     void getRotation(q_type& quat);
     void getPosition(q_vec_type& vec);
-    std::string getName();
+    const std::string& getName();
+    const std::string& getSerial();
+    void setSerial(const std::string& serial);
+    vr::ETrackedDeviceClass getDeviceClass();
+    void setTrackingState(vr::ETrackingResult result, bool valid);
+    vr::ETrackingResult getTrackingResult();
+    bool isTracking();
+    void setReportPolicy(const report_policy_t& policy);
+    void reportKeepalive(const struct timeval *now);
+    void attach(vr::IVRSystem * vr, vr::TrackedDeviceIndex_t trackedDeviceIndex);
+    void setDerivatives(int level);
+    virtual void inputEvent(const vr::VREvent_t *event, const struct timeval *now) {};
 
 protected:
+    vrpn_Tracker_OpenVR(const std::string& name, vrpn_Connection* connection, vr::ETrackedDeviceClass device_class_id);
+    void reportPose(bool repeat = false);
+    void reportDerivatives(bool hold);
 	vr::IVRSystem * vr;
     vr::ETrackedDeviceClass device_class_id;
     vr::TrackedDeviceIndex_t trackedDeviceIndex;
+    vr::ETrackingResult tracking_result;
+    bool pose_valid;
+    bool reportDue();
 private:
 	std::string name;
+    std::string serial;
+    report_policy_t report_policy;
+    q_vec_type report_pos;
+    q_type report_quat;
+    struct timeval report_tv;
+    bool reported;
+    int derivatives;            // DERIV_*, velocity comes from OpenVR pose only
+    deriv_state_t deriv;
 	q_matrix_type matrix;
 	static void ConvertSteamVRMatrixToQMatrix(const vr::HmdMatrix34_t &matPose, q_matrix_type &matrix);
 
@@ -2,10 +2,12 @@
 #include <iostream>
 #include <string>
 
-vrpn_Tracker_OpenVR_Controller::vrpn_Tracker_OpenVR_Controller(const std::string& name, vrpn_Connection* connection, vr::IVRSystem * vr, vr::TrackedDeviceIndex_t trackedDeviceIndex) :
+vrpn_Tracker_OpenVR_Controller::vrpn_Tracker_OpenVR_Controller(const std::string& name, vrpn_Connection* connection, vr::IVRSystem * vr, vr::TrackedDeviceIndex_t trackedDeviceIndex, bool input_events) :
 	vrpn_Tracker_OpenVR(name.c_str(), connection, vr, trackedDeviceIndex),
 	vrpn_Analog(name.c_str(), connection),
-	vrpn_Button_Filter(name.c_str(), connection)
+	vrpn_Button_Filter(name.c_str(), connection),
+	last_packet_num(0), last_pressed(0), last_touched(0),
+	input_events(input_events), state_synced(false), poll_axes(false)
 {
 	// Initialize the vrpn_Analog
 	vrpn_Analog::num_channel = vr::k_unControllerStateAxisCount * 2; // * 2 for x&y
@@ -21,33 +23,108 @@ vrpn_Tracker_OpenVR_Controller::vrpn_Tracker_OpenVR_Controller(const std::string
 }
 
 void vrpn_Tracker_OpenVR_Controller::mainloop() {
+    struct timeval now;
+
     updateController();
 
-    vrpn_gettimeofday( &(vrpn_Tracker_OpenVR::timestamp), NULL );
-	vrpn_Tracker_OpenVR::mainloop();
+    // one clock read per tick is enough for all three senders
+    vrpn_gettimeofday(&now, NULL);
+    vrpn_Tracker_OpenVR::timestamp = now;
+    vrpn_Tracker::server_mainloop();
+
+    vrpn_Analog::timestamp = now;
+    vrpn_Analog::report_changes();
+
+    vrpn_Button_Filter::timestamp = now;
+    vrpn_Button_Filter::report_changes();
+}
+
+/*
+    Button value is 1 when pressed, 2 when only touched, 0 otherwise.
+    Only buttons whose masks changed since previous state are rewritten.
+*/
+void vrpn_Tracker_OpenVR_Controller::updateButtons(uint64_t pressed, uint64_t touched) {
+    uint64_t changed = (pressed ^ last_pressed) | (touched ^ last_touched);
+
+    while (changed) {
+        unsigned int buttonId = 0;
+        uint64_t mask;
 
-	vrpn_gettimeofday( &(vrpn_Analog::timestamp), NULL );
-	vrpn_Analog::report_changes();
+        while (!(changed & (1ull << buttonId)))
+            buttonId++;
+        mask = 1ull << buttonId;
+        changed &= ~mask;
 
-    vrpn_gettimeofday( &(vrpn_Button_Filter::timestamp), NULL );
-	vrpn_Button_Filter::report_changes();
+        vrpn_Button_Filter::buttons[buttonId] = static_cast<unsigned char>((pressed & mask) ? 1 : (touched & mask) ? 2 : 0);
+    }
+
+    last_pressed = pressed;
+    last_touched = touched;
 }
 
 void vrpn_Tracker_OpenVR_Controller::updateController() {
     // Analog & Buttons
-    if (device_class_id == vr::TrackedDeviceClass_Controller)
+    if (device_class_id != vr::TrackedDeviceClass_Controller)
+        return;
+
+    /*
+        In event mode buttons come from inputEvent(), state is read once to
+        sync and then only while something is touched, since axes do not
+        generate events. The read after release picks up axes at rest.
+    */
+    if (input_events && state_synced && !poll_axes)
+        return;
+
+    if (!vr->GetControllerState(trackedDeviceIndex, &pControllerState, sizeof(pControllerState)))
+        return;
+
+    // nothing changed since previous read
+    if (state_synced && pControllerState.unPacketNum == last_packet_num)
+        return;
+    last_packet_num = pControllerState.unPacketNum;
+
+    if (!input_events || !state_synced)
+        updateButtons(pControllerState.ulButtonPressed, pControllerState.ulButtonTouched);
+    poll_axes = (pControllerState.ulButtonPressed | pControllerState.ulButtonTouched) != 0;
+    state_synced = true;
+
+    for (unsigned int axisId = 0; axisId < vr::k_unControllerStateAxisCount; ++axisId) {
+        vrpn_Analog::channel[axisId * 2] = pControllerState.rAxis[axisId].x;
+        vrpn_Analog::channel[axisId * 2 + 1] = pControllerState.rAxis[axisId].y;
+    }
+}
+
+/* button event from server event loop, reported with event time */
+void vrpn_Tracker_OpenVR_Controller::inputEvent(const vr::VREvent_t *event, const struct timeval *now) {
+    uint64_t pressed = last_pressed, touched = last_touched, mask;
+    long age_us;
+
+    if (!input_events || event->data.controller.button >= vr::k_EButton_Max)
+        return;
+
+    mask = vr::ButtonMaskFromId(static_cast<vr::EVRButtonId>(event->data.controller.button));
+
+    switch (event->eventType)
     {
-        vr->GetControllerState(trackedDeviceIndex, &pControllerState, sizeof(pControllerState));
-
-		for (unsigned int buttonId = 0; buttonId < vr::k_EButton_Max; ++buttonId) {
-			uint64_t mask = vr::ButtonMaskFromId(static_cast<vr::EVRButtonId>(buttonId));
-			vrpn_Button_Filter::buttons[buttonId] = static_cast<unsigned char>(((mask & pControllerState.ulButtonTouched) == mask) ? 2 : 0);
-			vrpn_Button_Filter::buttons[buttonId] = static_cast<unsigned char>(((mask & pControllerState.ulButtonPressed) == mask) ? 1 : vrpn_Button_Filter::buttons[buttonId]);
-		}
-
-		for (unsigned int axisId = 0; axisId < vr::k_unControllerStateAxisCount; ++axisId) {
-			vrpn_Analog::channel[axisId * 2] = pControllerState.rAxis[axisId].x;
-			vrpn_Analog::channel[axisId * 2 + 1] = pControllerState.rAxis[axisId].y;
-		}
+        case vr::VREvent_ButtonPress:   pressed |= mask; touched |= mask; break;
+        case vr::VREvent_ButtonUnpress: pressed &= ~mask; break;
+        case vr::VREvent_ButtonTouch:   touched |= mask; break;
+        case vr::VREvent_ButtonUntouch: touched &= ~mask; pressed &= ~mask; break;
+        default: return;
+    }
+
+    updateButtons(pressed, touched);
+
+    // axes are meaningful while touched
+    if (pressed | touched)
+        poll_axes = true;
+
+    age_us = static_cast<long>(event->eventAgeSeconds * 1000000.0f);
+    vrpn_Button_Filter::timestamp.tv_sec = now->tv_sec - age_us / 1000000;
+    vrpn_Button_Filter::timestamp.tv_usec = now->tv_usec - age_us % 1000000;
+    if (vrpn_Button_Filter::timestamp.tv_usec < 0) {
+        vrpn_Button_Filter::timestamp.tv_sec--;
+        vrpn_Button_Filter::timestamp.tv_usec += 1000000;
     }
+    vrpn_Button_Filter::report_changes();
 }
@@ -13,9 +13,14 @@ class vrpn_Tracker_OpenVR_Controller :
 {
 public:
 	vrpn_Tracker_OpenVR_Controller() = delete;
-	vrpn_Tracker_OpenVR_Controller(const std::string& name, vrpn_Connection* connection, vr::IVRSystem * vr, vr::TrackedDeviceIndex_t trackedDeviceIndex);
+	vrpn_Tracker_OpenVR_Controller(const std::string& name, vrpn_Connection* connection, vr::IVRSystem * vr, vr::TrackedDeviceIndex_t trackedDeviceIndex, bool input_events = false);
 	void mainloop();
+    void inputEvent(const vr::VREvent_t *event, const struct timeval *now);
 private:
     void updateController();
+    void updateButtons(uint64_t pressed, uint64_t touched);
     vr::VRControllerState_t pControllerState;
+    uint32_t last_packet_num;
+    uint64_t last_pressed, last_touched;
+    bool input_events, state_synced, poll_axes;
 };
\ No newline at end of file
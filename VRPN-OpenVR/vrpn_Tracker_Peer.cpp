@@ -0,0 +1,45 @@
+#include "vrpn_Tracker_Peer.h"
+
+vrpn_Tracker_Peer::vrpn_Tracker_Peer(const std::string& name, vrpn_Connection* connection, vr::ETrackedDeviceClass device_class_id, uint32_t node) :
+	vrpn_Tracker_OpenVR(name, connection, device_class_id), node(node), last_update(0)
+{
+}
+
+// pose received from peer, timestamp is already in local clock
+void vrpn_Tracker_Peer::updateTracking(const peer_pose_t *pose)
+{
+    d_sensor = 0;
+
+    pos[0] = pose->pos[0];
+    pos[1] = pose->pos[1];
+    pos[2] = pose->pos[2];
+
+    d_quat[0] = pose->quat[0];
+    d_quat[1] = pose->quat[1];
+    d_quat[2] = pose->quat[2];
+    d_quat[3] = pose->quat[3];
+
+    setTrackingState((vr::ETrackingResult)pose->tracking, pose->valid != 0);
+    last_update = pose->timestamp;
+
+    timestamp.tv_sec = (long)(pose->timestamp / 1000000);
+    timestamp.tv_usec = (long)(pose->timestamp % 1000000);
+    if (pose->valid)
+        reportPose();
+    else
+        reportKeepalive(&timestamp);
+}
+
+uint32_t vrpn_Tracker_Peer::getNode()
+{
+    return node;
+}
+
+int64_t vrpn_Tracker_Peer::getLastUpdate()
+{
+    return last_update;
+}
+
+void vrpn_Tracker_Peer::mainloop() {
+	vrpn_Tracker::server_mainloop();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <openvr.h>
+#include "vrpn_Tracker_OpenVR.h"
+#include "peer.h"
+
+class vrpn_Tracker_Peer :
+	public vrpn_Tracker_OpenVR
+{
+public:
+	vrpn_Tracker_Peer() = delete;
+	vrpn_Tracker_Peer(const std::string& name, vrpn_Connection* connection, vr::ETrackedDeviceClass device_class_id, uint32_t node);
+	void mainloop();
+    void updateTracking(const peer_pose_t *pose);
+    uint32_t getNode();
+    int64_t getLastUpdate();
+private:
+    uint32_t node;
+    int64_t last_update;
+};
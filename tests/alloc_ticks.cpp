@@ -0,0 +1,183 @@
+/*
+    Steady-state tick allocation test
+
+    Runs server main loop for synthetic ticks without OpenVR: poses of two
+    trackers come from peer sender in the same thread over loopback to
+    server's peer_listen port, camera fuses them through filters, dropout
+    handling and FreeD output, VRPN reports go with derivatives, report
+    policy and aggregate trackers. Tracker 0 drops out periodically, so
+    fusion and dropout paths switch during the run, and aggregator clock
+    pings are answered on every tick.
+
+    Built with ALLOC_COUNT, so operator new and (with glibc) malloc family
+    are counted for this thread. After warm-up (device discovery, socket
+    and console buffers, first clock ping) every tick must do zero heap
+    allocations, otherwise test fails.
+
+    Usage:
+
+        alloc_ticks [ticks 3000] [warmup 500] [vrpn_port 3899] [peer_port 7399] [freed_port 6399]
+
+    Console output of server is discarded, result is printed to stderr.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "vrpn_Server_OpenVR.h"
+#include "alloc_count.h"
+
+#define SYNTH_NODE      1
+#define SYNTH_DEVICES   2
+#define DROPOUT_PERIOD  400     // ticks
+#define DROPOUT_LENGTH  40      // ticks
+
+static void synth_pose(peer_pose_t* pose, int dev, int tick)
+{
+    double a = 0.5 * tick / 1000.0 + dev * 0.9;
+
+    memset(pose, 0, sizeof(*pose));
+    snprintf(pose->serial, PEER_SERIAL_LEN, "SYNTH-%u-%d", SYNTH_NODE, dev);
+    pose->device_class = vr::TrackedDeviceClass_GenericTracker;
+    pose->tracking = vr::TrackingResult_Running_OK;
+    pose->valid = 1;
+    pose->pos[0] = 1.5 * cos(a) + 0.1 * dev;
+    pose->pos[1] = 1.2 + 0.1 * sin(2.0 * a);
+    pose->pos[2] = 1.5 * sin(a);
+    pose->quat[1] = sin(-a / 2.0);
+    pose->quat[3] = cos(-a / 2.0);
+
+    if (!dev && (tick % DROPOUT_PERIOD) < DROPOUT_LENGTH)
+    {
+        pose->tracking = vr::TrackingResult_Running_OutOfRange;
+        pose->valid = 0;
+    }
+}
+
+static int64_t synth_clock()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv)
+{
+    int p, i, tick, ticks = 3000, warmup = 500, vrpn_port = 3899, peer_port = 7399, freed_port = 6399;
+    int bad_ticks = 0, bad_first = -1;
+    uint64_t total = 0, worst = 0;
+
+    for (p = 1; p + 1 < argc; p += 2)
+    {
+        if (!strcmp(argv[p], "ticks"))
+            ticks = atoi(argv[p + 1]);
+        else if (!strcmp(argv[p], "warmup"))
+            warmup = atoi(argv[p + 1]);
+        else if (!strcmp(argv[p], "vrpn_port"))
+            vrpn_port = atoi(argv[p + 1]);
+        else if (!strcmp(argv[p], "peer_port"))
+            peer_port = atoi(argv[p + 1]);
+        else if (!strcmp(argv[p], "freed_port"))
+            freed_port = atoi(argv[p + 1]);
+        else
+            break;
+    }
+    if (p < argc)
+    {
+        fprintf(stderr, "Failed to parse argument [%s], either unknown or wrong parameters count\n", argv[p]);
+        return 1;
+    }
+
+    if (!alloc_count_enabled())
+    {
+        fprintf(stderr, "alloc_ticks: built without ALLOC_COUNT\n");
+        return 1;
+    }
+
+    std::vector<std::string> args = {
+        "alloc_ticks",
+        "port", std::to_string(vrpn_port),
+        "peer_listen", std::to_string(peer_port),
+        "derivatives", "velocity",
+        "report", "all", "0.5", "0.5", "10", "0",
+        "aggregate", "synth/devices", "synth/cameras",
+        "cam", "ALLOC", "SYNTH-1-0", "0", "0.1", "0",
+            "filter", "gate", "5", "720",
+            "filter", "exp1", "0.2", "0.2",
+            "track", "SYNTH-1-1", "-0.1", "0", "0", "0", "0", "0",
+            "dropout", "extrapolate", "100", "50",
+            "freed", "127.0.0.1:" + std::to_string(freed_port),
+    };
+    std::vector<char*> server_argv;
+    for (auto& a : args)
+        server_argv.push_back(&a[0]);
+    server_argv.push_back(NULL);
+
+    // server console goes to null device
+    fflush(stdout);
+#if defined(_WIN32)
+    _dup2(_open("NUL", _O_WRONLY), 1);
+#else
+    dup2(open("/dev/null", O_WRONLY), STDOUT_FILENO);
+#endif
+
+    std::unique_ptr<vrpn_Server_OpenVR> server = std::make_unique<vrpn_Server_OpenVR>((int)args.size(), server_argv.data());
+
+    char target[64];
+    snprintf(target, sizeof(target), "127.0.0.1:%d", peer_port);
+    peer_sender tx(SYNTH_NODE, target);
+    peer_pose_t poses[SYNTH_DEVICES];
+
+    if (!tx.isOpen())
+        return 1;
+
+    for (tick = 0; tick < warmup + ticks; tick++)
+    {
+        uint64_t allocs;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        allocs = alloc_count();
+
+        for (i = 0; i < SYNTH_DEVICES; i++)
+        {
+            synth_pose(&poses[i], i, tick);
+            poses[i].timestamp = synth_clock();
+        }
+        tx.send(poses, SYNTH_DEVICES, synth_clock());
+        tx.poll();
+
+        server->mainloop();
+
+        allocs = alloc_count() - allocs;
+        if (tick < warmup)
+            continue;
+
+        total += allocs;
+        if (allocs > worst)
+            worst = allocs;
+        if (allocs)
+        {
+            if (bad_first < 0)
+                bad_first = tick - warmup;
+            bad_ticks++;
+        }
+    }
+
+    server.reset();
+
+    fprintf(stderr, "alloc_ticks: %d ticks after %d warm-up, malloc %s, allocations %llu, ticks with allocations %d (first %d, max %llu)\n",
+        ticks, warmup, alloc_count_malloc() ? "counted" : "not counted", (unsigned long long)total, bad_ticks, bad_first, (unsigned long long)worst);
+
+    return total ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+/*
+    Batch camera protocol reference decoder
+
+    Binds UDP port, decodes datagrams sent to "batch" targets (see
+    VRPN-OpenVR/batch.h) and periodically prints latest pose, velocities,
+    tracking state and age of every camera, datagram and tick rates, lost
+    datagrams and incomplete ticks. With "print 1" every camera record is
+    printed as it arrives.
+
+    Usage:
+
+        batch_dump [port 21000] [interval 1.0] [duration 0] [print 0]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <map>
+
+#include "tool_common.h"
+#include "batch.h"
+
+static int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void print_camera(batch_camera_t* cam, int64_t now)
+{
+    printf("ID %-4d state=%d trackers=%d pos=[%10.5f, %10.5f, %10.5f] quat=[%8.5f, %8.5f, %8.5f, %8.5f] "
+        "vel=[%8.4f, %8.4f, %8.4f] avel=[%8.4f, %8.4f, %8.4f] age=%.3fms\n",
+        cam->id, cam->state, cam->trackers, cam->pos[0], cam->pos[1], cam->pos[2],
+        cam->quat[0], cam->quat[1], cam->quat[2], cam->quat[3],
+        cam->vel[0], cam->vel[1], cam->vel[2], cam->avel[0], cam->avel[1], cam->avel[2],
+        (now - cam->timestamp) / 1000.0);
+}
+
+int main(int argc, char** argv)
+{
+    int sock, port = 21000, print = 0, coord = -1;
+    double interval = 1.0, duration = 0.0;
+    long datagrams = 0, ticks = 0, lost = 0, incomplete = 0, bad = 0;
+    long total_datagrams = 0, total_lost = 0, total_incomplete = 0, total_bad = 0;
+    uint32_t last_seq = 0;
+    int has_seq = 0, tick_parts = 0;
+    int64_t tick = 0;
+    std::map<int, batch_camera_t> cameras;
+    const tool_arg_t args[] =
+    {
+        { "port", TOOL_ARG_INT, &port },
+        { "interval", TOOL_ARG_DOUBLE, &interval },
+        { "duration", TOOL_ARG_DOUBLE, &duration },
+        { "print", TOOL_ARG_INT, &print },
+        { NULL, 0, NULL }
+    };
+
+    if (tool_args_parse(argc, argv, args))
+        return 1;
+
+    tool_start();
+
+    sock = tool_udp_bind(port);
+    if (sock < 0)
+        return 1;
+
+    printf("listening on UDP port %d\n", port);
+
+    int64_t start = now_us(), last_report = start;
+
+    while (!tool_done)
+    {
+        int r, i;
+        fd_set fds;
+        struct timeval tv;
+        unsigned char buf[BATCH_PACKET_MAX + 256];
+        batch_header_t hdr;
+        int64_t now;
+
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        tv.tv_sec = 0;
+        tv.tv_usec = 100000;
+
+        r = select(sock + 1, &fds, NULL, NULL, &tv);
+        now = now_us();
+
+        if (r > 0)
+        {
+            r = recv(sock, (char*)buf, sizeof(buf), 0);
+
+            if (batch_header_unpack(buf, r, &hdr))
+                bad++;
+            else
+            {
+                datagrams++;
+
+                /* loss by sequence gaps */
+                if (has_seq && (int32_t)(hdr.seq - last_seq) > 1)
+                    lost += hdr.seq - last_seq - 1;
+                last_seq = hdr.seq;
+                has_seq = 1;
+
+                /* tick is complete when all its datagrams arrived */
+                if (hdr.t_tick != tick)
+                {
+                    if (tick && tick_parts)
+                        incomplete++;
+                    tick = hdr.t_tick;
+                    tick_parts = hdr.parts;
+                }
+                if (--tick_parts == 0)
+                    ticks++;
+
+                coord = hdr.coord;
+
+                for (i = 0; i < hdr.count; i++)
+                {
+                    batch_camera_t cam;
+
+                    batch_camera_unpack(buf + BATCH_HEADER_SIZE + i * BATCH_CAMERA_SIZE, BATCH_CAMERA_SIZE, &cam);
+                    cameras[cam.id] = cam;
+
+                    if (print)
+                        print_camera(&cam, now);
+                }
+            }
+        }
+
+        if (now - last_report >= interval * 1000000.0)
+        {
+            double elapsed = (now - last_report) / 1000000.0;
+
+            printf("\ndatagrams/s=%.1f ticks/s=%.1f lost=%ld incomplete=%ld bad=%ld coord=%d\n",
+                datagrams / elapsed, ticks / elapsed, lost, incomplete, bad, coord);
+            if (!print)
+                for (auto& it : cameras)
+                    print_camera(&it.second, now);
+            fflush(stdout);
+
+            total_datagrams += datagrams;
+            total_lost += lost;
+            total_incomplete += incomplete;
+            total_bad += bad;
+            datagrams = ticks = lost = incomplete = bad = 0;
+            last_report = now;
+        }
+
+        if (duration > 0.0 && now - start >= duration * 1000000.0)
+            break;
+    }
+
+    printf("\ntotals over %.1f s: datagrams=%ld lost=%ld incomplete=%ld bad=%ld\n",
+        (now_us() - start) / 1000000.0, total_datagrams + datagrams, total_lost + lost,
+        total_incomplete + incomplete, total_bad + bad);
+
+    closesocket(sock);
+
+    return 0;
+}
@@ -0,0 +1,500 @@
+/*
+    VRPN fan-out benchmark
+
+    Measures how many VRPN clients one server connection can feed. For
+    every step of clients x devices grid it starts VRPN server connection
+    with synthetic trackers reporting at server tick rate (the way main
+    loop reports devices: pose of every device packed, then one
+    connection->mainloop()), spawns client threads, each with its own
+    connection and vrpn_Tracker_Remote for every device, and measures:
+
+        - server tick time: packing all poses and connection mainloop,
+          mean, 99th percentile and max, and achieved tick rate
+        - per-client delivered rate per device, minimum and mean of clients,
+          and share of reported poses delivered
+        - message latency: client receive time minus report timestamp
+
+    With "external" clients connect to running server instead (e.g.
+    VRPN-FreeD-OpenVR with "peer_listen 7000" fed by "peer_synth devices 4"),
+    only delivery and latency are measured then.
+
+    Every step is printed as one line, with "csv" also appended to file
+    together with "label", so runs of different builds can be compared.
+
+    Usage:
+
+        fanout_bench [clients 1,2,4,8,16,32,64] [devices 4] [rate 1000] [duration 5]
+            [warmup 1] [port 3890] [csv <file>] [label <build>]
+            [external <host:port> [node 1]]
+
+    Example:
+
+        fanout_bench clients 1,8,32,64 devices 4,16 duration 10 csv fanout.csv label v1.4
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <vrpn_Connection.h>
+#include <vrpn_Tracker.h>
+
+#define BENCH_LATENCY_BIN       10          // microseconds per latency histogram bin
+#define BENCH_LATENCY_BINS      10000       // 100 ms, later messages go to last bin
+#define BENCH_CONNECT_TIMEOUT   5.0         // seconds for all clients to connect
+
+typedef struct
+{
+    vrpn_Connection* connection;
+    std::vector<std::unique_ptr<vrpn_Tracker_Remote>> remotes;
+    std::atomic<long> received;
+    std::vector<uint32_t> latency;          // histogram, BENCH_LATENCY_BIN bins
+    double latency_max;                     // ms
+    std::thread thread;
+} bench_client_t;
+
+typedef struct
+{
+    int clients, devices, connected;
+    long ticks;
+    double duration;
+    double tick_mean, tick_p99, tick_max;   // ms
+    double pack_mean, mainloop_mean, mainloop_p99;
+    double rate;                            // ticks per second
+    double client_min, client_mean;         // poses per second per device
+    double delivered;                       // share of reported poses
+    double latency_p50, latency_p99, latency_max;
+} bench_result_t;
+
+static std::atomic<bool> clients_running, measuring;
+
+static double now_s()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void VRPN_CALLBACK handle_pose(void* userdata, const vrpn_TRACKERCB t)
+{
+    bench_client_t* cl = (bench_client_t*)userdata;
+    struct timeval now;
+    double lat;
+    long bin;
+
+    /* counters are owned by client thread, warmup is just not counted */
+    if (!measuring)
+        return;
+
+    vrpn_gettimeofday(&now, NULL);
+    lat = (now.tv_sec - t.msg_time.tv_sec) * 1000.0 + (now.tv_usec - t.msg_time.tv_usec) / 1000.0;
+
+    bin = (long)(lat * 1000.0 / BENCH_LATENCY_BIN);
+    if (bin < 0)
+        bin = 0;
+    if (bin >= BENCH_LATENCY_BINS)
+        bin = BENCH_LATENCY_BINS - 1;
+    cl->latency[bin]++;
+    if (lat > cl->latency_max)
+        cl->latency_max = lat;
+
+    cl->received++;
+}
+
+/* connection mainloop blocks until data arrives, so client reacts immediately */
+static void client_worker(bench_client_t* cl)
+{
+    struct timeval timeout = { 0, 10000 };
+
+    while (clients_running)
+        cl->connection->mainloop(&timeout);
+}
+
+static double percentile(std::vector<double>& v, double p)
+{
+    size_t i;
+
+    if (v.empty())
+        return 0.0;
+
+    i = (size_t)(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+static double histogram_percentile(const std::vector<uint64_t>& h, uint64_t total, double p)
+{
+    uint64_t acc = 0, target = (uint64_t)(p * total);
+    size_t i;
+
+    for (i = 0; i < h.size(); i++)
+    {
+        acc += h[i];
+        if (acc > target)
+            return (i + 0.5) * BENCH_LATENCY_BIN / 1000.0;
+    }
+
+    return h.size() * BENCH_LATENCY_BIN / 1000.0;
+}
+
+/* slow circle per device, like peer_synth sends */
+static void synth_pose(int dev, double t, vrpn_float64 pos[3], vrpn_float64 quat[4])
+{
+    double a = 0.5 * t + dev * 0.9;
+
+    pos[0] = 1.5 * cos(a);
+    pos[1] = 1.2 + 0.1 * sin(2.0 * a);
+    pos[2] = 1.5 * sin(a);
+    quat[0] = 0.0;
+    quat[1] = sin(-a / 2.0);
+    quat[2] = 0.0;
+    quat[3] = cos(-a / 2.0);
+}
+
+static int parse_list(const char* str, std::vector<int>& list)
+{
+    const char* s = str;
+    char* e;
+
+    list.clear();
+    while (*s)
+    {
+        long v = strtol(s, &e, 10);
+        if (e == s || v <= 0)
+            return -1;
+        list.push_back((int)v);
+        s = *e == ',' ? e + 1 : e;
+        if (*e && *e != ',')
+            return -1;
+    }
+
+    return list.empty() ? -1 : 0;
+}
+
+static int run_step(int port, const char* external, unsigned int node, int clients, int devices,
+    double rate, double warmup, double duration, bench_result_t* res)
+{
+    vrpn_Connection* server = NULL;
+    std::vector<std::unique_ptr<vrpn_Tracker_Server>> trackers;
+    std::vector<std::unique_ptr<bench_client_t>> cls;
+    std::vector<std::string> names;
+    std::vector<double> tick_times, mainloop_times;
+    double pack_sum = 0.0, period = rate > 0.0 ? 1.0 / rate : 0.0;
+    char host[300];
+    int c, d;
+
+    memset(res, 0, sizeof(*res));
+    res->clients = clients;
+    res->devices = devices;
+
+    for (d = 0; d < devices; d++)
+    {
+        char name[128];
+
+        if (external)
+            snprintf(name, sizeof(name), "openvr/GenericTracker/SYNTH-%u-%d", node, d);
+        else
+            snprintf(name, sizeof(name), "bench/dev%d", d);
+        names.push_back(name);
+    }
+
+    if (external)
+        snprintf(host, sizeof(host), "%s", external);
+    else
+    {
+        std::string connectionName = ":" + std::to_string(port);
+
+        server = vrpn_create_server_connection(connectionName.c_str());
+        if (!server || !server->doing_okay())
+        {
+            fprintf(stderr, "Failed to listen on port %d\n", port);
+            return -1;
+        }
+        for (d = 0; d < devices; d++)
+            trackers.push_back(std::make_unique<vrpn_Tracker_Server>(names[d].c_str(), server));
+        snprintf(host, sizeof(host), "localhost:%d", port);
+    }
+
+    /* every client gets its own connection, as separate nDisplay node would */
+    for (c = 0; c < clients; c++)
+    {
+        std::unique_ptr<bench_client_t> cl = std::make_unique<bench_client_t>();
+
+        cl->connection = vrpn_get_connection_by_name(host, NULL, NULL, NULL, NULL, NULL, true);
+        cl->received = 0;
+        cl->latency.assign(BENCH_LATENCY_BINS, 0);
+        cl->latency_max = 0.0;
+        for (d = 0; d < devices; d++)
+        {
+            std::string remote_name = names[d] + "@" + host;
+
+            cl->remotes.push_back(std::make_unique<vrpn_Tracker_Remote>(remote_name.c_str(), cl->connection));
+            cl->remotes.back()->register_change_handler(cl.get(), handle_pose);
+        }
+        cls.push_back(std::move(cl));
+    }
+
+    measuring = false;
+    clients_running = true;
+    for (auto& cl : cls)
+        cl->thread = std::thread(client_worker, cl.get());
+
+    tick_times.reserve((size_t)((rate > 0.0 ? rate : 100000.0) * (duration + 1.0)));
+    mainloop_times.reserve(tick_times.capacity());
+
+    double start = now_s(), deadline = start, measure = -1.0, stop = -1.0;
+    long ticks = 0;
+
+    while (1)
+    {
+        double t0 = now_s(), t1, t2;
+
+        /* measurement starts after warmup once all clients are connected */
+        if (measure < 0.0 && t0 - start >= warmup)
+        {
+            for (res->connected = 0, c = 0; c < clients; c++)
+                res->connected += cls[c]->connection->connected() ? 1 : 0;
+
+            if (res->connected == clients || t0 - start >= warmup + BENCH_CONNECT_TIMEOUT)
+            {
+                measuring = true;
+                measure = t0;
+                stop = t0 + duration;
+            }
+        }
+        if (stop > 0.0 && t0 >= stop)
+            break;
+
+        if (server)
+        {
+            struct timeval tv;
+
+            vrpn_gettimeofday(&tv, NULL);
+            for (d = 0; d < devices; d++)
+            {
+                vrpn_float64 pos[3], quat[4];
+
+                synth_pose(d, t0 - start, pos, quat);
+                trackers[d]->report_pose(0, tv, pos, quat);
+                trackers[d]->mainloop();
+            }
+            t1 = now_s();
+            server->mainloop();
+            t2 = now_s();
+
+            if (measure >= 0.0)
+            {
+                ticks++;
+                pack_sum += t1 - t0;
+                tick_times.push_back((t2 - t0) * 1000.0);
+                mainloop_times.push_back((t2 - t1) * 1000.0);
+            }
+        }
+
+        /* tick overrun is not caught up, as in server main loop */
+        deadline += period;
+        if (period > 0.0)
+        {
+            double left = deadline - now_s();
+
+            if (left > 0.0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(left));
+            else
+                deadline = now_s();
+        }
+        else if (!server)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    measuring = false;
+    clients_running = false;
+    for (auto& cl : cls)
+        cl->thread.join();
+
+    res->duration = now_s() - measure;
+    res->ticks = ticks;
+
+    if (server)
+    {
+        res->rate = ticks / res->duration;
+        res->pack_mean = ticks ? pack_sum / ticks * 1000.0 : 0.0;
+        for (double v : tick_times)
+            res->tick_mean += v;
+        res->tick_mean = ticks ? res->tick_mean / ticks : 0.0;
+        for (double v : mainloop_times)
+            res->mainloop_mean += v;
+        res->mainloop_mean = ticks ? res->mainloop_mean / ticks : 0.0;
+        res->tick_max = tick_times.empty() ? 0.0 : *std::max_element(tick_times.begin(), tick_times.end());
+        res->tick_p99 = percentile(tick_times, 0.99);
+        res->mainloop_p99 = percentile(mainloop_times, 0.99);
+    }
+
+    /* delivery and latency of all clients together */
+    std::vector<uint64_t> latency(BENCH_LATENCY_BINS, 0);
+    uint64_t total = 0;
+
+    res->client_min = -1.0;
+    for (auto& cl : cls)
+    {
+        double r = cl->received / res->duration / devices;
+
+        if (res->client_min < 0.0 || r < res->client_min)
+            res->client_min = r;
+        res->client_mean += r / clients;
+        for (size_t i = 0; i < latency.size(); i++)
+            latency[i] += cl->latency[i];
+        total += cl->received;
+        if (cl->latency_max > res->latency_max)
+            res->latency_max = cl->latency_max;
+    }
+    if (server && ticks)
+        res->delivered = (double)total / ((double)ticks * devices * clients);
+    res->latency_p50 = histogram_percentile(latency, total, 0.50);
+    res->latency_p99 = histogram_percentile(latency, total, 0.99);
+
+    for (auto& cl : cls)
+    {
+        cl->remotes.clear();
+        cl->connection->removeReference();
+    }
+    trackers.clear();
+    if (server)
+        server->removeReference();
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    int p, port = 3890, step = 0;
+    unsigned int node = 1;
+    double rate = 1000.0, duration = 5.0, warmup = 1.0;
+    const char *csv = NULL, *label = "", *external = NULL;
+    std::vector<int> clients = { 1, 2, 4, 8, 16, 32, 64 }, devices = { 4 };
+    FILE* csv_file = NULL;
+
+    for (p = 1; p < argc;)
+    {
+        if (!strcmp(argv[p], "clients") && (p + 1) < argc && !parse_list(argv[p + 1], clients))
+            p += 2;
+        else if (!strcmp(argv[p], "devices") && (p + 1) < argc && !parse_list(argv[p + 1], devices))
+            p += 2;
+        else if (!strcmp(argv[p], "rate") && (p + 1) < argc)
+        {
+            rate = atof(argv[p + 1]);
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "duration") && (p + 1) < argc)
+        {
+            duration = atof(argv[p + 1]);
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "warmup") && (p + 1) < argc)
+        {
+            warmup = atof(argv[p + 1]);
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "port") && (p + 1) < argc)
+        {
+            port = atoi(argv[p + 1]);
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "csv") && (p + 1) < argc)
+        {
+            csv = argv[p + 1];
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "label") && (p + 1) < argc)
+        {
+            label = argv[p + 1];
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "external") && (p + 1) < argc)
+        {
+            external = argv[p + 1];
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "node") && (p + 1) < argc)
+        {
+            node = atoi(argv[p + 1]);
+            p += 2;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to parse argument [%s], either unknown or wrong parameters count\n", argv[p]);
+            return 1;
+        }
+    }
+
+    if (duration <= 0.0 || rate < 0.0)
+    {
+        fprintf(stderr, "duration should be positive and rate not negative\n");
+        return 1;
+    }
+
+    if (csv)
+    {
+        bool fresh;
+
+        csv_file = fopen(csv, "r");
+        fresh = !csv_file;
+        if (csv_file)
+            fclose(csv_file);
+
+        csv_file = fopen(csv, "a");
+        if (!csv_file)
+        {
+            fprintf(stderr, "Failed to open [%s]\n", csv);
+            return 1;
+        }
+        if (fresh)
+            fprintf(csv_file, "label,clients,devices,connected,rate,tick_mean_ms,tick_p99_ms,tick_max_ms,pack_mean_ms,mainloop_mean_ms,mainloop_p99_ms,"
+                "client_min_hz,client_mean_hz,delivered,latency_p50_ms,latency_p99_ms,latency_max_ms\n");
+    }
+
+    if (external)
+        printf("clients of %s, devices SYNTH-%u-*, %.1f s per step\n", external, node, duration);
+    else
+        printf("server at %.1f Hz on port %d+, %.1f s per step\n", rate, port, duration);
+    printf("%7s %7s %9s | %8s %8s %8s %8s %8s %8s | %9s %9s %7s | %8s %8s %8s\n",
+        "clients", "devices", "connected", "tick Hz", "tick", "p99", "max", "pack", "mainloop",
+        "min Hz", "mean Hz", "deliv", "lat p50", "p99", "max");
+
+    for (int dv : devices)
+    {
+        for (int cn : clients)
+        {
+            bench_result_t r;
+
+            /* fresh port every step, sockets of previous one may linger */
+            if (run_step(port + step++, external, node, cn, dv, rate, warmup, duration, &r))
+                return 1;
+
+            printf("%7d %7d %5d/%-3d | %8.1f %8.3f %8.3f %8.3f %8.3f %8.3f | %9.1f %9.1f %6.1f%% | %8.3f %8.3f %8.3f\n",
+                r.clients, r.devices, r.connected, r.clients, r.rate, r.tick_mean, r.tick_p99, r.tick_max,
+                r.pack_mean, r.mainloop_mean, r.client_min, r.client_mean, r.delivered * 100.0,
+                r.latency_p50, r.latency_p99, r.latency_max);
+            fflush(stdout);
+
+            if (csv_file)
+            {
+                fprintf(csv_file, "%s,%d,%d,%d,%.1f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.1f,%.1f,%.4f,%.4f,%.4f,%.4f\n",
+                    label, r.clients, r.devices, r.connected, r.rate, r.tick_mean, r.tick_p99, r.tick_max,
+                    r.pack_mean, r.mainloop_mean, r.mainloop_p99, r.client_min, r.client_mean, r.delivered,
+                    r.latency_p50, r.latency_p99, r.latency_max);
+                fflush(csv_file);
+            }
+        }
+    }
+
+    if (csv_file)
+        fclose(csv_file);
+
+    return 0;
+}
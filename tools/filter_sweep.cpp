@@ -0,0 +1,579 @@
+/*
+    Offline filter evaluation and parameter sweep
+
+    Runs filter chain built from filter.h over recorded pose log and
+    reports, against zero-phase reference (centered moving average of raw
+    positions and rotations):
+
+        lag         - time shift of output that best matches reference, ms
+        error       - RMS of lag compensated output error, mm
+        rot error   - RMS of lag compensated output rotation angle error, deg
+        jitter      - RMS of output high frequency residual, mm
+        overshoot   - max excursion of output beyond local reference range, mm
+        cost        - filter chain time per sample, ns
+
+    Log is either CSV with lines "t,x,y,z[,qx,qy,qz,qw]" (t in seconds,
+    positions in meters, '#' comments and header allowed) or binary file of
+    shmem_pose_t records (see shmem.h).
+
+    With "sweep" last filter of chain takes parameters from a grid, all
+    configurations are evaluated on all CPU cores with work-stealing pool
+    and ranked by score = w_lag * lag + w_jitter * jitter + w_overshoot * overshoot
+    + w_rot * rot error.
+
+    Usage:
+
+        filter_sweep log <file> [filter <type> <a> <b>]... [sweep <type> <a0:a1:n[:log]> <b0:b1:n[:log]>]
+            [threads 0] [top 10] [ref_window 21] [max_lag 100] [weights 1.0 1.0 0.5] [weight_rot 10.0]
+
+    Example:
+
+        filter_sweep log take3.csv sweep exp1 0.001:0.5:24:log 0.001:0.5:24:log top 5
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <functional>
+
+#include "filter.h"
+#include "shmem.h"
+
+typedef struct
+{
+    double t;
+    q_vec_type pos;
+    q_type quat;
+} sample_t;
+
+typedef struct
+{
+    std::string type;
+    double a, b;
+} filter_spec_t;
+
+typedef struct
+{
+    std::vector<filter_spec_t> chain;
+    double lag_ms, error_mm, error_deg, jitter_mm, overshoot_mm, ns_per_sample, score;
+} result_t;
+
+typedef struct
+{
+    double from, to;
+    int steps, log;
+} range_t;
+
+static int ref_window = 21, max_lag_ms = 100;
+static double w_lag = 1.0, w_jitter = 1.0, w_overshoot = 0.5, w_rot = 10.0;
+
+static int load_csv(const char* path, std::vector<sample_t>& samples)
+{
+    char line[1024];
+    FILE* f = fopen(path, "rt");
+
+    if (!f)
+        return -1;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        sample_t s;
+        int n;
+
+        if (line[0] == '#')
+            continue;
+
+        s.quat[0] = s.quat[1] = s.quat[2] = 0.0;
+        s.quat[3] = 1.0;
+        n = sscanf(line, "%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf", &s.t, &s.pos[0], &s.pos[1], &s.pos[2],
+            &s.quat[0], &s.quat[1], &s.quat[2], &s.quat[3]);
+
+        /* header or broken line */
+        if (n < 4)
+            continue;
+
+        samples.push_back(s);
+    }
+
+    fclose(f);
+
+    return 0;
+}
+
+static int load_bin(const char* path, std::vector<sample_t>& samples)
+{
+    shmem_pose_t pose;
+    FILE* f = fopen(path, "rb");
+
+    if (!f)
+        return -1;
+
+    while (fread(&pose, sizeof(pose), 1, f) == 1)
+    {
+        sample_t s;
+
+        if (!pose.valid)
+            continue;
+
+        s.t = pose.timestamp / 1000000.0;
+        memcpy(s.pos, pose.pos, sizeof(s.pos));
+        memcpy(s.quat, pose.quat, sizeof(s.quat));
+        samples.push_back(s);
+    }
+
+    fclose(f);
+
+    return 0;
+}
+
+/* centered moving average, window shrinks at edges */
+static void moving_average(const std::vector<q_vec_type*>& in, std::vector<double>& out, int window)
+{
+    int i, j, n = (int)in.size(), h = window / 2;
+
+    out.assign(n * 3, 0.0);
+
+    for (i = 0; i < n; i++)
+    {
+        int from = std::max(0, i - h), to = std::min(n - 1, i + h);
+        for (j = 0; j < 3; j++)
+        {
+            double sum = 0.0;
+            int k;
+            for (k = from; k <= to; k++)
+                sum += (*in[k])[j];
+            out[i * 3 + j] = sum / (to - from + 1);
+        }
+    }
+}
+
+/* centered average of rotations, aligned to hemisphere of center sample and normalized */
+static void moving_average_rot(const std::vector<sample_t>& in, std::vector<double>& out, int window)
+{
+    int i, j, k, n = (int)in.size(), h = window / 2;
+
+    out.assign(n * 4, 0.0);
+
+    for (i = 0; i < n; i++)
+    {
+        int from = std::max(0, i - h), to = std::min(n - 1, i + h);
+        double sum[4] = { 0.0, 0.0, 0.0, 0.0 }, norm = 0.0;
+
+        for (k = from; k <= to; k++)
+        {
+            double dot = 0.0, s;
+            for (j = 0; j < 4; j++)
+                dot += in[k].quat[j] * in[i].quat[j];
+            s = dot < 0.0 ? -1.0 : 1.0;
+            for (j = 0; j < 4; j++)
+                sum[j] += s * in[k].quat[j];
+        }
+
+        for (j = 0; j < 4; j++)
+            norm += sum[j] * sum[j];
+        norm = sqrt(norm);
+        for (j = 0; j < 4; j++)
+            out[i * 4 + j] = norm > 0.0 ? sum[j] / norm : (j == 3 ? 1.0 : 0.0);
+    }
+}
+
+/* RMS of angle between output rotation and reference shifted by lag, radians */
+static double rms_rot_shifted(const std::vector<double>& out, const std::vector<double>& ref, int shift)
+{
+    int i, j, n = (int)out.size() / 4;
+    double sum = 0.0;
+
+    for (i = shift; i < n; i++)
+    {
+        double dot = 0.0, a;
+        for (j = 0; j < 4; j++)
+            dot += out[i * 4 + j] * ref[(i - shift) * 4 + j];
+        dot = fabs(dot);
+        a = 2.0 * acos(dot > 1.0 ? 1.0 : dot);
+        sum += a * a;
+    }
+
+    return n > shift ? sqrt(sum / (n - shift)) : 0.0;
+}
+
+static double rms_shifted(const std::vector<double>& out, const std::vector<double>& ref, int shift)
+{
+    int i, n = (int)out.size() / 3;
+    double sum = 0.0;
+
+    for (i = shift; i < n; i++)
+    {
+        double dx = out[i * 3] - ref[(i - shift) * 3];
+        double dy = out[i * 3 + 1] - ref[(i - shift) * 3 + 1];
+        double dz = out[i * 3 + 2] - ref[(i - shift) * 3 + 2];
+        sum += dx * dx + dy * dy + dz * dz;
+    }
+
+    return n > shift ? sqrt(sum / (n - shift)) : 0.0;
+}
+
+static void evaluate(const std::vector<sample_t>& samples, const std::vector<double>& ref, const std::vector<double>& ref_rot,
+    double dt, result_t* r)
+{
+    int i, j, n = (int)samples.size(), shift, best, step, max_shift;
+    std::vector<std::unique_ptr<filter_abstract>> filters;
+    std::vector<double> out(n * 3), out_rot(n * 4), smooth;
+    std::vector<q_vec_type*> out_ptr(n);
+    double best_rms;
+
+    for (const auto& fs : r->chain)
+        filters.emplace_back(filter_create(fs.type.c_str(), fs.a, fs.b));
+
+    /* run chain */
+    auto start = std::chrono::steady_clock::now();
+    for (i = 0; i < n; i++)
+    {
+        q_vec_type pos;
+        q_type rot;
+
+        memcpy(pos, samples[i].pos, sizeof(pos));
+        memcpy(rot, samples[i].quat, sizeof(rot));
+
+        for (auto& f : filters)
+            f->process_data(pos, rot, samples[i].t);
+
+        memcpy(&out[i * 3], pos, sizeof(pos));
+        memcpy(&out_rot[i * 4], rot, sizeof(rot));
+    }
+    r->ns_per_sample = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+
+    /* lag: coarse scan then refine */
+    max_shift = (int)(max_lag_ms / 1000.0 / dt);
+    if (max_shift > n / 2)
+        max_shift = n / 2;
+    step = std::max(1, max_shift / 25);
+    for (best = 0, best_rms = rms_shifted(out, ref, 0), shift = step; shift <= max_shift; shift += step)
+    {
+        double e = rms_shifted(out, ref, shift);
+        if (e < best_rms)
+        {
+            best_rms = e;
+            best = shift;
+        }
+    }
+    for (shift = std::max(0, best - step + 1); shift <= std::min(max_shift, best + step - 1); shift++)
+    {
+        double e = rms_shifted(out, ref, shift);
+        if (e < best_rms)
+        {
+            best_rms = e;
+            best = shift;
+        }
+    }
+    r->lag_ms = best * dt * 1000.0;
+    r->error_mm = best_rms * 1000.0;
+    r->error_deg = rms_rot_shifted(out_rot, ref_rot, best) * 180.0 / 3.1415926;
+
+    /* jitter: residual of output around its own smoothed version */
+    for (i = 0; i < n; i++)
+        out_ptr[i] = (q_vec_type*)&out[i * 3];
+    moving_average(out_ptr, smooth, ref_window);
+    {
+        double sum = 0.0;
+        for (i = 0; i < n * 3; i++)
+            sum += (out[i] - smooth[i]) * (out[i] - smooth[i]);
+        r->jitter_mm = sqrt(sum / n) * 1000.0;
+    }
+
+    /* overshoot: output beyond range of lag compensated reference around that point */
+    r->overshoot_mm = 0.0;
+    for (i = best; i < n; i++)
+    {
+        int k, c = i - best, h = ref_window / 2;
+        int from = std::max(0, c - h), to = std::min(n - 1, c + h);
+
+        for (j = 0; j < 3; j++)
+        {
+            double lo = ref[from * 3 + j], hi = lo, o;
+
+            for (k = from + 1; k <= to; k++)
+            {
+                lo = std::min(lo, ref[k * 3 + j]);
+                hi = std::max(hi, ref[k * 3 + j]);
+            }
+
+            o = std::max(out[i * 3 + j] - hi, lo - out[i * 3 + j]);
+            if (o * 1000.0 > r->overshoot_mm)
+                r->overshoot_mm = o * 1000.0;
+        }
+    }
+
+    r->score = w_lag * r->lag_ms + w_jitter * r->jitter_mm + w_overshoot * r->overshoot_mm + w_rot * r->error_deg;
+}
+
+/*
+    Work-stealing pool: every worker takes jobs from back of its own queue,
+    when empty it steals from front of others, so costly configurations do
+    not leave cores idle.
+*/
+static void run_pool(int jobs, int threads, std::function<void(int)> fn)
+{
+    typedef struct
+    {
+        std::mutex lock;
+        std::deque<int> jobs;
+    } queue_t;
+    std::vector<std::unique_ptr<queue_t>> queues;
+    std::vector<std::thread> workers;
+    int i;
+
+    for (i = 0; i < threads; i++)
+        queues.emplace_back(new queue_t);
+    for (i = 0; i < jobs; i++)
+        queues[i % threads]->jobs.push_back(i);
+
+    for (i = 0; i < threads; i++)
+        workers.emplace_back([&, i]()
+        {
+            while (1)
+            {
+                int t, job = -1;
+
+                for (t = 0; t < threads && job < 0; t++)
+                {
+                    queue_t* q = queues[(i + t) % threads].get();
+                    std::lock_guard<std::mutex> guard(q->lock);
+
+                    if (q->jobs.empty())
+                        continue;
+
+                    if (!t)
+                    {
+                        job = q->jobs.back();
+                        q->jobs.pop_back();
+                    }
+                    else
+                    {
+                        job = q->jobs.front();
+                        q->jobs.pop_front();
+                    }
+                }
+
+                if (job < 0)
+                    break;
+
+                fn(job);
+            }
+        });
+
+    for (auto& w : workers)
+        w.join();
+}
+
+static int parse_range(const char* str, range_t* r)
+{
+    char mode[8] = "";
+
+    r->log = 0;
+    if (sscanf(str, "%lf:%lf:%d:%7s", &r->from, &r->to, &r->steps, mode) < 3 || r->steps < 1)
+        return -1;
+    r->log = !strcmp(mode, "log");
+    if (r->log && (r->from <= 0.0 || r->to <= 0.0))
+        return -1;
+
+    return 0;
+}
+
+static int parse_number(const char* str, double* v)
+{
+    char* end;
+
+    *v = strtod(str, &end);
+
+    return end == str || *end ? -1 : 0;
+}
+
+static double range_value(range_t* r, int i)
+{
+    double k = r->steps > 1 ? (double)i / (r->steps - 1) : 0.0;
+
+    if (r->log)
+        return r->from * pow(r->to / r->from, k);
+    return r->from + (r->to - r->from) * k;
+}
+
+static void print_result(const result_t& r)
+{
+    std::string chain;
+
+    for (const auto& fs : r.chain)
+    {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "%s%s %g %g", chain.empty() ? "" : " -> ", fs.type.c_str(), fs.a, fs.b);
+        chain += buf;
+    }
+
+    printf("%9.3f %9.3f %9.3f %9.4f %9.3f %11.3f %9.1f   %s\n", r.score, r.lag_ms, r.error_mm, r.error_deg, r.jitter_mm, r.overshoot_mm,
+        r.ns_per_sample, chain.empty() ? "(raw)" : chain.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    int p, i, threads = 0, top = 10;
+    const char* log = NULL;
+    std::vector<filter_spec_t> chain;
+    std::string sweep_type;
+    range_t ra, rb;
+    std::vector<sample_t> samples;
+    std::vector<result_t> results;
+
+    for (p = 1; p < argc;)
+    {
+        if (!strcmp(argv[p], "log") && (p + 1) < argc)
+        {
+            log = argv[p + 1];
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "filter") && (p + 3) < argc)
+        {
+            filter_spec_t fs = { argv[p + 1], 0.0, 0.0 };
+            const char* reason = "parameters should be numbers";
+            if (parse_number(argv[p + 2], &fs.a) || parse_number(argv[p + 3], &fs.b) ||
+                (reason = filter_check(argv[p + 1], fs.a, fs.b)) != NULL)
+            {
+                fprintf(stderr, "Failed to parse filter [%s %s %s], %s\n", argv[p + 1], argv[p + 2], argv[p + 3], reason);
+                return 1;
+            }
+            chain.push_back(fs);
+            p += 4;
+        }
+        else if (!strcmp(argv[p], "sweep") && (p + 3) < argc)
+        {
+            const char* reason = "range should be <from:to:steps[:log]>";
+            /* constraints are intervals, so both ends of grid are enough */
+            if (parse_range(argv[p + 2], &ra) || parse_range(argv[p + 3], &rb) ||
+                (reason = filter_check(argv[p + 1], ra.from, rb.from)) != NULL ||
+                (reason = filter_check(argv[p + 1], ra.to, rb.to)) != NULL)
+            {
+                fprintf(stderr, "Failed to parse sweep [%s %s %s], %s\n", argv[p + 1], argv[p + 2], argv[p + 3], reason);
+                return 1;
+            }
+            sweep_type = argv[p + 1];
+            p += 4;
+        }
+        else if (!strcmp(argv[p], "threads") && (p + 1) < argc)
+        {
+            threads = atoi(argv[p + 1]);
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "top") && (p + 1) < argc)
+        {
+            top = atoi(argv[p + 1]);
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "ref_window") && (p + 1) < argc)
+        {
+            ref_window = atoi(argv[p + 1]) | 1;
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "max_lag") && (p + 1) < argc)
+        {
+            max_lag_ms = atoi(argv[p + 1]);
+            p += 2;
+        }
+        else if (!strcmp(argv[p], "weights") && (p + 3) < argc)
+        {
+            w_lag = atof(argv[p + 1]);
+            w_jitter = atof(argv[p + 2]);
+            w_overshoot = atof(argv[p + 3]);
+            p += 4;
+        }
+        else if (!strcmp(argv[p], "weight_rot") && (p + 1) < argc)
+        {
+            w_rot = atof(argv[p + 1]);
+            p += 2;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to parse argument [%s], either unknown or wrong parameters count\n", argv[p]);
+            return 1;
+        }
+    }
+
+    if (!log)
+    {
+        fprintf(stderr, "log file is not specified\n");
+        return 1;
+    }
+
+    i = (int)strlen(log);
+    if ((i > 4 && !strcmp(log + i - 4, ".csv") ? load_csv(log, samples) : load_bin(log, samples)) || samples.size() < 16)
+    {
+        fprintf(stderr, "Failed to load enough samples from [%s]\n", log);
+        return 1;
+    }
+
+    /* median sample interval */
+    std::vector<double> dts;
+    for (i = 1; i < (int)samples.size(); i++)
+        dts.push_back(samples[i].t - samples[i - 1].t);
+    std::nth_element(dts.begin(), dts.begin() + dts.size() / 2, dts.end());
+    double dt = dts[dts.size() / 2] > 0.0 ? dts[dts.size() / 2] : FILTER_REF_DT;
+
+    /* zero-phase reference */
+    std::vector<q_vec_type*> raw(samples.size());
+    std::vector<double> ref;
+    for (i = 0; i < (int)samples.size(); i++)
+        raw[i] = (q_vec_type*)&samples[i].pos;
+    moving_average(raw, ref, ref_window);
+    std::vector<double> ref_rot;
+    moving_average_rot(samples, ref_rot, ref_window);
+
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    printf("%zu samples, %.3f s, median interval %.3f ms, reference window %d samples\n",
+        samples.size(), samples.back().t - samples.front().t, dt * 1000.0, ref_window);
+
+    /* raw input and fixed chain first, then grid */
+    results.resize(2);
+    results[1].chain = chain;
+    if (!sweep_type.empty())
+    {
+        int a, b;
+        for (a = 0; a < ra.steps; a++)
+            for (b = 0; b < rb.steps; b++)
+            {
+                result_t r;
+                filter_spec_t fs = { sweep_type, range_value(&ra, a), range_value(&rb, b) };
+                r.chain = chain;
+                r.chain.push_back(fs);
+                results.push_back(r);
+            }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    run_pool((int)results.size(), threads, [&](int job) { evaluate(samples, ref, ref_rot, dt, &results[job]); });
+    double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%zu configurations evaluated in %.2f s on %d threads\n\n", results.size(), took, threads);
+    printf("%9s %9s %9s %9s %9s %11s %9s   %s\n", "score", "lag ms", "error mm", "error deg", "jitter mm", "overshoot mm", "ns/sample", "chain");
+
+    print_result(results[0]);
+    if (!chain.empty())
+        print_result(results[1]);
+
+    if (results.size() > 2)
+    {
+        printf("\nbest %d of sweep:\n", top);
+        std::sort(results.begin() + 2, results.end(), [](const result_t& x, const result_t& y) { return x.score < y.score; });
+        for (i = 2; i < (int)results.size() && i < top + 2; i++)
+            print_result(results[i]);
+    }
+
+    return 0;
+}
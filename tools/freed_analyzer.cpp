@@ -0,0 +1,309 @@
+/*
+    FreeD stream analyzer
+
+    Binds UDP port, decodes D1 packets and reports per camera ID statistics:
+    rate, inter-arrival jitter histogram, gaps, duplicates, reordering and
+    pose discontinuities. If server sends sequence counter in Spare field
+    (freed target option seq=1) loss and reordering are counted exactly,
+    otherwise gaps are detected by inter-arrival time.
+
+    Usage:
+
+        freed_analyzer [port 20000] [interval 1.0] [duration 0] [jump 10.0] [jump_deg 2.0]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <map>
+
+#include "tool_common.h"
+#include "FreeD.h"
+
+#define HIST_BINS 12
+
+/* inter-arrival histogram bins upper bounds, milliseconds */
+static const double hist_bounds[HIST_BINS - 1] = { 0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 16.0, 24.0, 40.0, 100.0, 1000.0 };
+
+typedef struct
+{
+    /* counters since last report */
+    long packets, lost, dups, reordered, gaps, jumps, degraded;
+    double ia_sum, ia_sum2, ia_min, ia_max;
+    long hist[HIST_BINS];
+
+    /* totals */
+    long total_packets, total_lost, total_dups, total_reordered, total_gaps, total_jumps, total_degraded;
+
+    /* state */
+    double last_arrival, ia_avg;
+    int has_prev, has_seq;
+    FreeD_D1_t prev;
+    unsigned char prev_buf[FREE_D_D1_PACKET_SIZE];
+    long seq_abs_max;
+    long seq_seen[FREE_D_SPARE_SEQ_MASK + 1];
+} cam_stat_t;
+
+static double now_sec()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double angle_diff(double a, double b)
+{
+    double d = fmod(fabs(a - b), 360.0);
+    return d > 180.0 ? 360.0 - d : d;
+}
+
+static void stat_reset_interval(cam_stat_t* st)
+{
+    st->packets = st->lost = st->dups = st->reordered = st->gaps = st->jumps = st->degraded = 0;
+    st->ia_sum = st->ia_sum2 = st->ia_max = 0.0;
+    st->ia_min = 1e9;
+    memset(st->hist, 0, sizeof(st->hist));
+}
+
+static void stat_process(cam_stat_t* st, unsigned char* buf, FreeD_D1_t* d, double arrival, double jump_mm, double jump_deg)
+{
+    int spare = FREE_D_SPARE_GET(d);
+
+    /* sequence counter based loss, duplicates and reordering */
+    if (spare & FREE_D_SPARE_SEQ_FLAG)
+    {
+        int seq = spare & FREE_D_SPARE_SEQ_MASK;
+
+        if (!st->has_seq)
+        {
+            st->has_seq = 1;
+            st->seq_abs_max = seq;
+            memset(st->seq_seen, 0xFF, sizeof(st->seq_seen));
+            st->seq_seen[seq] = seq;
+        }
+        else
+        {
+            long delta, abs;
+
+            /* extend 12-bit counter to absolute value around last maximum */
+            delta = (seq - st->seq_abs_max) & FREE_D_SPARE_SEQ_MASK;
+            if (delta > FREE_D_SPARE_SEQ_MASK / 2)
+                delta -= FREE_D_SPARE_SEQ_MASK + 1;
+            abs = st->seq_abs_max + delta;
+
+            if (st->seq_seen[seq] == abs)
+            {
+                st->dups++;
+                return;
+            }
+            st->seq_seen[seq] = abs;
+
+            if (delta > 0)
+            {
+                st->lost += delta - 1;
+                st->seq_abs_max = abs;
+            }
+            else
+            {
+                /* late packet was counted as lost, unless that was in previous interval */
+                st->reordered++;
+                if (st->lost > 0)
+                    st->lost--;
+            }
+        }
+    }
+    /* without counter identical payload means duplicate */
+    else if (st->has_prev && !memcmp(buf, st->prev_buf, FREE_D_D1_PACKET_SIZE))
+    {
+        st->dups++;
+        return;
+    }
+
+    st->packets++;
+
+    /* camera tracking state reported by server (freed target option state=1) */
+    if (spare & FREE_D_SPARE_STATE_MASK)
+        st->degraded++;
+
+    /* inter-arrival time */
+    if (st->has_prev)
+    {
+        double ia = (arrival - st->last_arrival) * 1000.0;
+        int b;
+
+        st->ia_sum += ia;
+        st->ia_sum2 += ia * ia;
+        if (ia < st->ia_min) st->ia_min = ia;
+        if (ia > st->ia_max) st->ia_max = ia;
+
+        for (b = 0; b < (HIST_BINS - 1) && ia > hist_bounds[b]; b++);
+        st->hist[b]++;
+
+        /* time based gap detection when counter is not available */
+        if (!st->has_seq && st->ia_avg > 0.0 && ia > 2.5 * st->ia_avg)
+            st->gaps++;
+        st->ia_avg = st->ia_avg > 0.0 ? 0.99 * st->ia_avg + 0.01 * ia : ia;
+
+        /* pose discontinuities */
+        double dx = d->X - st->prev.X, dy = d->Y - st->prev.Y, dz = d->Z - st->prev.Z;
+        if (sqrt(dx * dx + dy * dy + dz * dz) > jump_mm ||
+            angle_diff(d->Pan, st->prev.Pan) > jump_deg ||
+            angle_diff(d->Tilt, st->prev.Tilt) > jump_deg ||
+            angle_diff(d->Roll, st->prev.Roll) > jump_deg)
+            st->jumps++;
+    }
+
+    st->has_prev = 1;
+    st->last_arrival = arrival;
+    st->prev = *d;
+    memcpy(st->prev_buf, buf, FREE_D_D1_PACKET_SIZE);
+}
+
+static void stat_report(std::map<int, cam_stat_t*>& stats, double period, long bad_size, long bad_header, long bad_checksum)
+{
+    int b;
+
+    printf("\n%-4s %9s %9s %9s %9s %9s %7s %7s %7s %7s %7s %7s\n",
+        "ID", "rate", "ia avg", "jitter", "ia min", "ia max", "lost", "dups", "reord", "gaps", "jumps", "degrad");
+
+    for (auto& it : stats)
+    {
+        cam_stat_t* st = it.second;
+        long n = st->packets > 1 ? st->packets - 1 : 0;
+        double avg = n ? st->ia_sum / n : 0.0;
+        double jitter = n ? sqrt(fmax(0.0, st->ia_sum2 / n - avg * avg)) : 0.0;
+
+        printf("%-4d %9.2f %9.3f %9.3f %9.3f %9.3f %7ld %7ld %7ld %7ld %7ld %7ld\n",
+            it.first, st->packets / period, avg, jitter, n ? st->ia_min : 0.0, st->ia_max,
+            st->lost, st->dups, st->reordered, st->gaps, st->jumps, st->degraded);
+
+        printf("     hist ms:");
+        for (b = 0; b < HIST_BINS; b++)
+        {
+            if (b < HIST_BINS - 1)
+                printf(" <=%g:%ld", hist_bounds[b], st->hist[b]);
+            else
+                printf(" >%g:%ld", hist_bounds[b - 1], st->hist[b]);
+        }
+        printf("\n");
+
+        st->total_packets += st->packets;
+        st->total_lost += st->lost;
+        st->total_dups += st->dups;
+        st->total_reordered += st->reordered;
+        st->total_gaps += st->gaps;
+        st->total_jumps += st->jumps;
+        st->total_degraded += st->degraded;
+
+        stat_reset_interval(st);
+    }
+
+    if (bad_size || bad_header || bad_checksum)
+        printf("malformed: size=%ld header=%ld checksum=%ld\n", bad_size, bad_header, bad_checksum);
+
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    int sock, port = 20000;
+    double interval = 1.0, duration = 0.0, jump_mm = 10.0, jump_deg = 2.0;
+    long bad_size = 0, bad_header = 0, bad_checksum = 0;
+    std::map<int, cam_stat_t*> stats;
+    const tool_arg_t args[] =
+    {
+        { "port", TOOL_ARG_INT, &port },
+        { "interval", TOOL_ARG_DOUBLE, &interval },
+        { "duration", TOOL_ARG_DOUBLE, &duration },
+        { "jump", TOOL_ARG_DOUBLE, &jump_mm },
+        { "jump_deg", TOOL_ARG_DOUBLE, &jump_deg },
+        { NULL, 0, NULL }
+    };
+
+    if (tool_args_parse(argc, argv, args))
+        return 1;
+
+    tool_start();
+
+    sock = tool_udp_bind(port);
+    if (sock < 0)
+        return 1;
+
+    printf("listening on UDP port %d\n", port);
+
+    double start = now_sec(), last_report = start;
+
+    while (!tool_done)
+    {
+        int r;
+        fd_set fds;
+        struct timeval tv;
+        unsigned char buf[2048];
+        FreeD_D1_t d;
+        double now;
+
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        tv.tv_sec = 0;
+        tv.tv_usec = 100000;
+
+        r = select(sock + 1, &fds, NULL, NULL, &tv);
+        now = now_sec();
+
+        if (r > 0)
+        {
+            r = recv(sock, (char*)buf, sizeof(buf), 0);
+
+            if (r != FREE_D_D1_PACKET_SIZE)
+                bad_size++;
+            else if (buf[0] != 0xD1)
+                bad_header++;
+            else if (FreeD_D1_check(buf, r))
+                bad_checksum++;
+            else
+            {
+                cam_stat_t* st;
+
+                FreeD_D1_unpack(buf, r, &d);
+
+                auto it = stats.find(d.ID);
+                if (it == stats.end())
+                {
+                    st = (cam_stat_t*)calloc(1, sizeof(cam_stat_t));
+                    stat_reset_interval(st);
+                    stats[d.ID] = st;
+                }
+                else
+                    st = it->second;
+
+                stat_process(st, buf, &d, now, jump_mm, jump_deg);
+            }
+        }
+
+        if (now - last_report >= interval)
+        {
+            stat_report(stats, now - last_report, bad_size, bad_header, bad_checksum);
+            bad_size = bad_header = bad_checksum = 0;
+            last_report = now;
+        }
+
+        if (duration > 0.0 && now - start >= duration)
+            break;
+    }
+
+    stat_report(stats, now_sec() - last_report, bad_size, bad_header, bad_checksum);
+
+    printf("\ntotals over %.1f s:\n", now_sec() - start);
+    for (auto& it : stats)
+    {
+        cam_stat_t* st = it.second;
+        printf("ID %-4d packets=%ld lost=%ld dups=%ld reordered=%ld gaps=%ld jumps=%ld degraded=%ld sequenced=%s\n",
+            it.first, st->total_packets, st->total_lost, st->total_dups, st->total_reordered,
+            st->total_gaps, st->total_jumps, st->total_degraded, st->has_seq ? "yes" : "no");
+        free(st);
+    }
+
+    closesocket(sock);
+
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+    FreeD load generator
+
+    Emits FreeD D1 packets for many camera IDs with synthetic motion at
+    configurable rate, to stress receivers. Packets of one tick are sent as
+    a burst (optionally with a single sendmmsg call on Linux) or evenly
+    spread over tick period. Reports achieved packets per second and CPU
+    cost per packet.
+
+    Usage:
+
+        freed_generator [host 127.0.0.1] [port 20000] [ports 1] [cameras 16] [rate 1000]
+            [duration 0] [motion circle|sine|static] [pace burst|spread] [spin 200]
+            [mmsg 1] [seq 1] [interval 1.0]
+
+    Camera IDs are 8-bit, so cameras above 255 are sent to next port(s),
+    number of ports is increased automatically.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "tool_common.h"
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "FreeD.h"
+
+#define MAX_IDS_PER_PORT 255
+
+typedef std::chrono::steady_clock clk;
+
+static double cpu_sec()
+{
+#if defined(_WIN32)
+    FILETIME c, e, k, u;
+    GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u);
+    return (((unsigned long long)k.dwHighDateTime << 32 | k.dwLowDateTime) +
+        ((unsigned long long)u.dwHighDateTime << 32 | u.dwLowDateTime)) / 1e7;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+/* sleep until deadline, spinning last spin_us microseconds for precision */
+static void wait_until(clk::time_point deadline, int spin_us)
+{
+    clk::time_point coarse = deadline - std::chrono::microseconds(spin_us);
+
+    if (clk::now() < coarse)
+        std::this_thread::sleep_until(coarse);
+
+    while (clk::now() < deadline);
+}
+
+static void motion(const char* type, int cam, double t, FreeD_D1_t* d)
+{
+    double ph = cam * 0.37;
+
+    d->ID = (cam % MAX_IDS_PER_PORT) + 1;
+
+    if (!strcmp(type, "circle"))
+    {
+        d->X = 2000.0 * cos(0.5 * t + ph);
+        d->Y = 2000.0 * sin(0.5 * t + ph);
+        d->Z = 1500.0 + 100.0 * sin(2.0 * t + ph);
+        d->Pan = fmod(0.5 * t * 180.0 / 3.1415926 + 90.0 + ph * 180.0 / 3.1415926, 360.0) - 180.0;
+        d->Tilt = 10.0 * sin(1.3 * t + ph);
+        d->Roll = 2.0 * sin(0.7 * t + ph);
+    }
+    else if (!strcmp(type, "sine"))
+    {
+        d->X = 500.0 * sin(1.0 * t + ph);
+        d->Y = 500.0 * sin(1.7 * t + ph);
+        d->Z = 1500.0 + 300.0 * sin(0.9 * t + ph);
+        d->Pan = 45.0 * sin(0.8 * t + ph);
+        d->Tilt = 20.0 * sin(1.1 * t + ph);
+        d->Roll = 5.0 * sin(1.9 * t + ph);
+    }
+    else
+    {
+        d->X = 100.0 * cam;
+        d->Y = d->Z = 0.0;
+        d->Pan = d->Tilt = d->Roll = 0.0;
+    }
+
+    d->Zoom = d->Focus = 0;
+}
+
+int main(int argc, char** argv)
+{
+    int i, sock, port = 20000, ports = 1, cameras = 16, spin_us = 200, use_mmsg = 0, use_seq = 1;
+    double rate = 1000.0, duration = 0.0, interval = 1.0;
+    const char *host = "127.0.0.1", *motion_type = "circle", *pace = "burst";
+    std::vector<struct sockaddr_in> addrs;
+    std::vector<unsigned char> bufs;
+    std::vector<unsigned int> seqs;
+
+    const tool_arg_t args[] =
+    {
+        { "host", TOOL_ARG_STRING, &host },
+        { "port", TOOL_ARG_INT, &port },
+        { "ports", TOOL_ARG_INT, &ports },
+        { "cameras", TOOL_ARG_INT, &cameras },
+        { "rate", TOOL_ARG_DOUBLE, &rate },
+        { "duration", TOOL_ARG_DOUBLE, &duration },
+        { "interval", TOOL_ARG_DOUBLE, &interval },
+        { "motion", TOOL_ARG_STRING, &motion_type },
+        { "pace", TOOL_ARG_STRING, &pace },
+        { "spin", TOOL_ARG_INT, &spin_us },
+        { "mmsg", TOOL_ARG_INT, &use_mmsg },
+        { "seq", TOOL_ARG_INT, &use_seq },
+        { NULL, 0, NULL }
+    };
+
+    if (tool_args_parse(argc, argv, args))
+        return 1;
+
+    if (cameras < 1 || rate <= 0.0)
+    {
+        fprintf(stderr, "cameras and rate should be positive\n");
+        return 1;
+    }
+
+    if (ports < (cameras + MAX_IDS_PER_PORT - 1) / MAX_IDS_PER_PORT)
+        ports = (cameras + MAX_IDS_PER_PORT - 1) / MAX_IDS_PER_PORT;
+
+#if !defined(__linux__)
+    if (use_mmsg)
+    {
+        fprintf(stderr, "sendmmsg is not available on this platform, using sendto\n");
+        use_mmsg = 0;
+    }
+#endif
+
+    tool_start();
+
+    sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        fprintf(stderr, "Failed to create socket\n");
+        return 1;
+    }
+
+    /* per camera destination, packet buffer and sequence counter */
+    addrs.resize(cameras);
+    bufs.resize(cameras * FREE_D_D1_PACKET_SIZE);
+    seqs.resize(cameras, 0);
+    for (i = 0; i < cameras; i++)
+    {
+        memset(&addrs[i], 0, sizeof(struct sockaddr_in));
+        addrs[i].sin_family = AF_INET;
+        addrs[i].sin_addr.s_addr = inet_addr(host);
+        addrs[i].sin_port = htons((unsigned short)(port + i / MAX_IDS_PER_PORT));
+    }
+
+#if defined(__linux__)
+    std::vector<struct mmsghdr> msgs(cameras);
+    std::vector<struct iovec> iovs(cameras);
+    for (i = 0; i < cameras; i++)
+    {
+        iovs[i].iov_base = &bufs[i * FREE_D_D1_PACKET_SIZE];
+        iovs[i].iov_len = FREE_D_D1_PACKET_SIZE;
+        memset(&msgs[i], 0, sizeof(struct mmsghdr));
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+
+    printf("sending %d cameras at %.1f Hz to %s:%d..%d, motion=%s pace=%s mmsg=%d seq=%d\n",
+        cameras, rate, host, port, port + ports - 1, motion_type, pace, use_mmsg, use_seq);
+
+    int spread = !strcmp(pace, "spread");
+    std::chrono::nanoseconds period((long long)(1e9 / rate));
+    clk::time_point start = clk::now(), deadline = start, last_report = start;
+    double cpu_start = cpu_sec(), cpu_last = cpu_start;
+    long sent = 0, errors = 0, late = 0, ticks = 0;
+    long total_sent = 0, total_errors = 0, total_late = 0;
+
+    while (!tool_done)
+    {
+        double t = std::chrono::duration<double>(deadline - start).count();
+
+        wait_until(deadline, spin_us);
+
+        /* tick deadline already passed by more then a period */
+        if (clk::now() - deadline > period)
+            late++;
+
+        /* build packets of tick */
+        for (i = 0; i < cameras; i++)
+        {
+            FreeD_D1_t d;
+
+            memset(&d, 0, sizeof(d));
+            motion(motion_type, i, t, &d);
+            if (use_seq)
+            {
+                FREE_D_SPARE_SET(&d, FREE_D_SPARE_SEQ_FLAG | (seqs[i] & FREE_D_SPARE_SEQ_MASK));
+                seqs[i]++;
+            }
+            FreeD_D1_pack(&bufs[i * FREE_D_D1_PACKET_SIZE], FREE_D_D1_PACKET_SIZE, &d);
+        }
+
+        /* send them */
+        if (use_mmsg && !spread)
+        {
+#if defined(__linux__)
+            for (i = 0; i < cameras;)
+            {
+                int r = sendmmsg(sock, &msgs[i], cameras - i, 0);
+                if (r <= 0)
+                {
+                    errors += cameras - i;
+                    break;
+                }
+                sent += r;
+                i += r;
+            }
+#endif
+        }
+        else
+        {
+            for (i = 0; i < cameras; i++)
+            {
+                if (spread && i)
+                    wait_until(deadline + period * i / cameras, spin_us);
+
+                if (sendto(sock, (char*)&bufs[i * FREE_D_D1_PACKET_SIZE], FREE_D_D1_PACKET_SIZE, 0,
+                    (struct sockaddr*)&addrs[i], sizeof(struct sockaddr_in)) == FREE_D_D1_PACKET_SIZE)
+                    sent++;
+                else
+                    errors++;
+            }
+        }
+
+        ticks++;
+        deadline += period;
+
+        clk::time_point now = clk::now();
+        double elapsed = std::chrono::duration<double>(now - last_report).count();
+        if (elapsed >= interval)
+        {
+            double cpu = cpu_sec();
+
+            printf("pps=%10.1f ticks/s=%8.1f late=%6ld errors=%6ld cpu=%5.1f%% cpu/pkt=%7.0f ns\n",
+                sent / elapsed, ticks / elapsed, late, errors,
+                100.0 * (cpu - cpu_last) / elapsed,
+                sent ? 1e9 * (cpu - cpu_last) / sent : 0.0);
+            fflush(stdout);
+
+            total_sent += sent; total_errors += errors; total_late += late;
+            sent = errors = late = ticks = 0;
+            cpu_last = cpu;
+            last_report = now;
+        }
+
+        if (duration > 0.0 && std::chrono::duration<double>(now - start).count() >= duration)
+            break;
+    }
+
+    total_sent += sent; total_errors += errors; total_late += late;
+
+    double wall = std::chrono::duration<double>(clk::now() - start).count();
+    double cpu = cpu_sec() - cpu_start;
+    printf("\ntotal: packets=%ld errors=%ld late ticks=%ld wall=%.2f s pps=%.1f cpu=%.1f%% cpu/pkt=%.0f ns\n",
+        total_sent, total_errors, total_late, wall, total_sent / wall, 100.0 * cpu / wall,
+        total_sent ? 1e9 * cpu / total_sent : 0.0);
+
+    closesocket(sock);
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+    Peer mode test tool
+
+    Sends synthetic device poses using peer protocol, as a server started
+    with "peer_send" would, so aggregator can be tested without Lighthouse
+    setups. Clock of synthetic peer can be shifted to check offset
+    estimation. With "listen" it works as a bare aggregator and prints
+    per-peer statistics instead, so several instances can be tested on one
+    host over loopback:
+
+        peer_synth listen 7000
+        peer_synth host 127.0.0.1 port 7000 node 1 devices 4 offset 250
+        peer_synth host 127.0.0.1 port 7000 node 2 devices 2 offset -40 rate 500
+
+    Usage:
+
+        peer_synth [host 127.0.0.1] [port 7000] [node 1] [devices 4] [rate 1000]
+            [offset 0 ms] [duration 0] [interval 1.0] [listen <port>]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "tool_common.h"
+#include "peer_link.h"
+
+static int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/* slow circle per device, rotation about vertical axis follows path */
+static void synth_pose(peer_pose_t* pose, uint32_t node, int dev, double t)
+{
+    double ph = dev * 0.9 + node * 0.3, a = 0.5 * t + ph;
+
+    memset(pose, 0, sizeof(*pose));
+    snprintf(pose->serial, PEER_SERIAL_LEN, "SYNTH-%u-%d", node, dev);
+    pose->device_class = 3;     // vr::TrackedDeviceClass_GenericTracker
+    pose->tracking = 200;       // vr::TrackingResult_Running_OK
+    pose->valid = 1;
+    pose->pos[0] = 1.5 * cos(a);
+    pose->pos[1] = 1.2 + 0.1 * sin(2.0 * a);
+    pose->pos[2] = 1.5 * sin(a);
+    pose->quat[1] = sin(-a / 2.0);
+    pose->quat[3] = cos(-a / 2.0);
+}
+
+int main(int argc, char** argv)
+{
+    int port = 7000, devices = 4, listen_port = 0;
+    unsigned int node = 1;
+    double rate = 1000.0, offset_ms = 0.0, duration = 0.0, interval = 1.0;
+    const char* host = "127.0.0.1";
+
+    const tool_arg_t args[] =
+    {
+        { "host", TOOL_ARG_STRING, &host },
+        { "port", TOOL_ARG_INT, &port },
+        { "node", TOOL_ARG_UINT, &node },
+        { "devices", TOOL_ARG_INT, &devices },
+        { "rate", TOOL_ARG_DOUBLE, &rate },
+        { "offset", TOOL_ARG_DOUBLE, &offset_ms },
+        { "duration", TOOL_ARG_DOUBLE, &duration },
+        { "interval", TOOL_ARG_DOUBLE, &interval },
+        { "listen", TOOL_ARG_INT, &listen_port },
+        { NULL, 0, NULL }
+    };
+
+    if (tool_args_parse(argc, argv, args))
+        return 1;
+
+    if (rate <= 0.0 || devices < 0)
+    {
+        fprintf(stderr, "rate should be positive\n");
+        return 1;
+    }
+
+    tool_start();
+
+    std::chrono::nanoseconds period((long long)(1e9 / rate));
+    auto start = std::chrono::steady_clock::now(), deadline = start, last_report = start;
+
+    if (listen_port)
+    {
+        peer_aggregator agg(listen_port);
+        std::vector<peer_pose_t> poses;
+        long received = 0;
+
+        if (!agg.isOpen())
+            return 1;
+
+        printf("aggregating peers on UDP port %d\n", listen_port);
+
+        while (!tool_done)
+        {
+            poses.clear();
+            received += agg.poll(now_us(), poses);
+
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - last_report).count();
+            if (elapsed >= interval)
+            {
+                printf("\nposes/s=%.1f\n", received / elapsed);
+                for (const auto& it : agg.getPeers())
+                {
+                    const peer_stat_t& st = it.second;
+                    printf("node %-4u %-21s offset=%9.3fms%s rtt=%7.3fms latency=%7.3fms (max %7.3f) age=%7.3fms packets=%ld lost=%ld\n",
+                        st.node, st.addr.c_str(), st.offset / 1000.0, st.synced ? "" : "?", st.rtt / 1000.0,
+                        st.latency / 1000.0, st.latency_max / 1000.0, st.age / 1000.0, st.packets, st.lost);
+                }
+                fflush(stdout);
+                received = 0;
+                last_report = now;
+            }
+
+            if (duration > 0.0 && std::chrono::duration<double>(now - start).count() >= duration)
+                break;
+
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+
+        return 0;
+    }
+
+    char target[300];
+    snprintf(target, sizeof(target), "%s:%d", host, port);
+
+    peer_sender tx(node, target);
+    std::vector<peer_pose_t> poses(devices);
+    int64_t offset_us = (int64_t)(offset_ms * 1000.0);
+
+    if (!tx.isOpen())
+        return 1;
+    tx.setClockOffset(offset_us);
+
+    printf("node %u sending %d synthetic devices at %.1f Hz to %s, clock offset %.3f ms\n", node, devices, rate, target, offset_ms);
+
+    while (!tool_done)
+    {
+        int i;
+        int64_t now;
+        double t = std::chrono::duration<double>(deadline - start).count();
+
+        std::this_thread::sleep_until(deadline);
+        deadline += period;
+
+        /* shifted clock of this peer */
+        now = now_us() + offset_us;
+
+        for (i = 0; i < devices; i++)
+        {
+            synth_pose(&poses[i], node, i, t);
+            poses[i].timestamp = now;
+        }
+
+        tx.send(poses.data(), devices, now);
+        tx.poll();
+
+        if (duration > 0.0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= duration)
+            break;
+    }
+
+    return 0;
+}
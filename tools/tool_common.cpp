@@ -0,0 +1,76 @@
+#include "tool_common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+volatile int tool_done = 0;
+
+static void handle_signal(int)
+{
+    tool_done = 1;
+}
+
+int tool_args_parse(int argc, char** argv, const tool_arg_t* args)
+{
+    int p;
+
+    for (p = 1; p < argc; p += 2)
+    {
+        const tool_arg_t* a;
+
+        for (a = args; a->name && strcmp(a->name, argv[p]); a++);
+
+        if (!a->name || p + 1 >= argc)
+        {
+            fprintf(stderr, "Failed to parse argument [%s], either unknown or wrong parameters count\n", argv[p]);
+            return -1;
+        }
+
+        switch (a->type)
+        {
+            case TOOL_ARG_INT: *(int*)a->value = atoi(argv[p + 1]); break;
+            case TOOL_ARG_UINT: *(unsigned int*)a->value = (unsigned int)strtoul(argv[p + 1], NULL, 10); break;
+            case TOOL_ARG_DOUBLE: *(double*)a->value = atof(argv[p + 1]); break;
+            case TOOL_ARG_STRING: *(const char**)a->value = argv[p + 1]; break;
+        }
+    }
+
+    return 0;
+}
+
+void tool_start()
+{
+#if defined(_WIN32)
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+}
+
+int tool_udp_bind(int port)
+{
+    struct sockaddr_in addr;
+    int sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock < 0)
+    {
+        fprintf(stderr, "Failed to create socket\n");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((unsigned short)port);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)))
+    {
+        fprintf(stderr, "Failed to bind UDP port %d\n", port);
+        closesocket(sock);
+        return -1;
+    }
+
+    return sock;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+    Helpers shared by command line tools: "name value" argument parsing,
+    ^C handling and UDP socket setup.
+*/
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/select.h>
+#define closesocket close
+#endif
+
+/* argument value types */
+#define TOOL_ARG_INT        0
+#define TOOL_ARG_UINT       1
+#define TOOL_ARG_DOUBLE     2
+#define TOOL_ARG_STRING     3       // const char*, points into argv
+
+typedef struct
+{
+    const char* name;
+    int type;
+    void* value;
+} tool_arg_t;
+
+/* set by SIGINT/SIGTERM */
+extern volatile int tool_done;
+
+/* parse "name value" pairs by table terminated with NULL name, 0 on success, message printed on error */
+int tool_args_parse(int argc, char** argv, const tool_arg_t* args);
+
+/* sockets and signal handlers */
+void tool_start();
+
+/* UDP socket bound to port on all interfaces, -1 with message printed on error */
+int tool_udp_bind(int port);